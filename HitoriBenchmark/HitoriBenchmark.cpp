@@ -0,0 +1,237 @@
+#include "../HitoriSolver/Hitori.h"
+
+#include <fstream>
+#include <chrono>
+#include <cstdio>
+
+// A table to benchmark and its measurements.
+struct BenchmarkCase {
+    std::string name;
+    TableValues values;
+    std::vector<double> latencies;
+    SearchStats stats;
+    unsigned long long solutionCount = 0;
+};
+
+// Solves the case repeatCount times from scratch, recording the wall clock
+// time of every run and the work of the last one; the search is
+// deterministic, so every run does the same work.
+void runCase(BenchmarkCase &benchmarkCase, unsigned repeatCount) {
+    visitTableType(benchmarkCase.values.size, [&](auto tableType) {
+        using TableType = typename decltype(tableType)::type;
+        for (auto run = 0U; run < repeatCount; run++) {
+            const auto start = std::chrono::steady_clock::now();
+            TableType t(benchmarkCase.values);
+            SearchStats stats;
+            benchmarkCase.solutionCount = countSolutions(t, 1, &stats);
+            const auto finish = std::chrono::steady_clock::now();
+
+            benchmarkCase.latencies.push_back(std::chrono::duration<double, std::micro>(finish - start).count());
+            benchmarkCase.stats = stats;
+        }
+    });
+}
+
+// Clicks the solution of the case into a BoardEditor, the cells in random
+// order, then takes the clicks back in another, recording the latency of
+// every edit. Cells the earlier clicks forced aren't clicked. The case
+// counts as solved if the clicks solved the board.
+void runEdits(BenchmarkCase &benchmarkCase, std::mt19937_64 &random) {
+    visitTableType(benchmarkCase.values.size, [&](auto tableType) {
+        using TableType = typename decltype(tableType)::type;
+        using Editor = BoardEditor<TableType>;
+        TableType solution(benchmarkCase.values);
+        if (countSolutions(solution, 1) == 0) {
+            return;
+        }
+
+        const auto size = benchmarkCase.values.size;
+        std::vector<unsigned> cells(size * size);
+        for (auto pos = 0U; pos < cells.size(); pos++) {
+            cells[pos] = pos;
+        }
+        std::shuffle(cells.begin(), cells.end(), random);
+
+        Editor editor(benchmarkCase.values);
+        std::vector<unsigned> clicked;
+        const auto timeEdit = [&](unsigned pos, TableBase::Cell::State state) {
+            const auto start = std::chrono::steady_clock::now();
+            const auto status = editor.setCell(pos / size, pos % size, state);
+            const auto finish = std::chrono::steady_clock::now();
+            benchmarkCase.latencies.push_back(std::chrono::duration<double, std::micro>(finish - start).count());
+            return status;
+        };
+        for (const auto pos : cells) {
+            if (editor.getTable().getCell(pos / size, pos % size).getState() == TableBase::Cell::State::Unknown) {
+                timeEdit(pos, solution.getCell(pos / size, pos % size).getState());
+                clicked.push_back(pos);
+            }
+        }
+        benchmarkCase.solutionCount = editor.getStatus() == Editor::Status::Solved ? 1 : 0;
+
+        std::shuffle(clicked.begin(), clicked.end(), random);
+        for (const auto pos : clicked) {
+            timeEdit(pos, TableBase::Cell::State::Unknown);
+        }
+    });
+}
+
+// The value below which fraction of the sorted samples fall.
+double getPercentile(const std::vector<double> &sorted, double fraction) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    const auto rank = static_cast<size_t>(fraction * sorted.size() + 0.999999);
+    return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+// Prints one JSON object per line, so the results can be compared between
+// builds with a script.
+void printResult(const std::string &name, unsigned size, std::vector<double> latencies,
+                 const SearchStats &stats, unsigned long long solutionCount, unsigned puzzleCount) {
+    std::sort(latencies.begin(), latencies.end());
+    auto total = 0.0;
+    for (const auto latency : latencies) {
+        total += latency;
+    }
+    const auto runsPerPuzzle = std::max<size_t>(latencies.size() / std::max(puzzleCount, 1U), 1);
+    const auto nodesPerSecond = total > 0 ? static_cast<double>(stats.nodes) * runsPerPuzzle / (total / 1e6) : 0.0;
+
+    char line[512];
+    std::snprintf(line, sizeof(line),
+        "{\"name\":\"%s\",\"size\":%u,\"puzzles\":%u,\"runs\":%zu,\"median_us\":%.1f,\"p99_us\":%.1f,"
+        "\"nodes_per_puzzle\":%.1f,\"branch_points_per_puzzle\":%.1f,\"nodes_per_sec\":%.0f,\"solved\":%llu}\n",
+        name.c_str(), size, puzzleCount, latencies.size(), getPercentile(latencies, 0.5), getPercentile(latencies, 0.99),
+        static_cast<double>(stats.nodes) / std::max(puzzleCount, 1U),
+        static_cast<double>(stats.branchPoints) / std::max(puzzleCount, 1U), nodesPerSecond, solutionCount);
+    std::cout << line;
+}
+
+int main(int argc, char **argv) {
+    std::ios::sync_with_stdio(false);
+
+    auto repeatCount = 11U;
+    auto minSize = 5U;
+    auto maxSize = 25U;
+    auto boardsPerSize = 5U;
+    auto seed = 1ULL;
+    auto timeEdits = false;
+    std::vector<std::string> files;
+    for (auto i = 1; i < argc; i++) {
+        const std::string arg(argv[i]);
+        if (arg == "--repeat" && i + 1 < argc) {
+            repeatCount = std::max(static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10)), 1U);
+
+        } else if (arg == "--sizes" && i + 1 < argc) {
+            char *end = nullptr;
+            minSize = static_cast<unsigned>(std::strtoul(argv[++i], &end, 10));
+            maxSize = *end == '-' ? static_cast<unsigned>(std::strtoul(end + 1, nullptr, 10)) : minSize;
+
+        } else if (arg == "--boards" && i + 1 < argc) {
+            boardsPerSize = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = std::strtoull(argv[++i], nullptr, 10);
+
+        } else if (arg == "--edits") {
+            timeEdits = true;
+
+        } else if (arg == "--help") {
+            std::cout << "Usage: HitoriBenchmark [--repeat N] [--sizes A-B] [--boards N] [--seed S] [--edits] [table.txt...]\n";
+            std::cout << "  --repeat N   solve every table N times, defaults to 11\n";
+            std::cout << "  --sizes A-B  sizes of the generated boards, defaults to 5-25\n";
+            std::cout << "  --boards N   generated boards per size, defaults to 5, 0 disables them\n";
+            std::cout << "  --seed S     seed of the board generator, defaults to 1\n";
+            std::cout << "  --edits      also time clicking the generated boards solved cell by cell and back\n";
+            std::cout << "Without table files the bundled table_*.txt of the working directory are used.\n";
+            std::cout << "Prints one JSON object per table, generated size and in total.\n";
+            return 0;
+
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    if (files.empty()) {
+        for (const auto name : {"table_easy.txt", "table_moderate.txt", "table_hard.txt", "table_master.txt"}) {
+            if (std::ifstream(name).good()) {
+                files.push_back(name);
+            }
+        }
+    }
+
+    std::vector<BenchmarkCase> tableCases;
+    for (const auto &file : files) {
+        std::ifstream in(file, std::ios::binary);
+        if (!in.good()) {
+            std::cerr << "Unable to open " << file << " for reading\n";
+            return 1;
+        }
+
+        std::vector<Puzzle> puzzles;
+        readPuzzles(in, file, puzzles);
+        for (auto &puzzle : puzzles) {
+            if (!puzzle.error.empty()) {
+                std::cerr << puzzle.id << ": " << puzzle.error << '\n';
+                return 2;
+            }
+            BenchmarkCase benchmarkCase;
+            benchmarkCase.name = puzzle.id;
+            benchmarkCase.values = std::move(puzzle.values);
+            tableCases.push_back(std::move(benchmarkCase));
+        }
+    }
+
+    std::vector<double> allLatencies;
+    SearchStats allStats;
+    auto allSolved = 0ULL;
+    auto allPuzzles = 0U;
+    const auto addToTotal = [&](const BenchmarkCase &benchmarkCase) {
+        allLatencies.insert(allLatencies.end(), benchmarkCase.latencies.begin(), benchmarkCase.latencies.end());
+        allStats.nodes += benchmarkCase.stats.nodes;
+        allStats.branchPoints += benchmarkCase.stats.branchPoints;
+        allSolved += benchmarkCase.solutionCount;
+        allPuzzles++;
+    };
+
+    for (auto &benchmarkCase : tableCases) {
+        runCase(benchmarkCase, repeatCount);
+        printResult(benchmarkCase.name, benchmarkCase.values.size, benchmarkCase.latencies,
+                    benchmarkCase.stats, benchmarkCase.solutionCount, 1);
+        addToTotal(benchmarkCase);
+    }
+
+    // Every size gets its own generator seeded from seed, so the boards of
+    // a size don't change when the range of sizes does.
+    for (auto size = minSize; boardsPerSize != 0 && size <= maxSize; size++) {
+        std::mt19937_64 random(seed * 1000003 + size);
+        std::vector<double> sizeLatencies;
+        SearchStats sizeStats;
+        auto sizeSolved = 0ULL;
+        BenchmarkCase editCase;
+        auto editsSolved = 0ULL;
+        for (auto board = 0U; board < boardsPerSize; board++) {
+            BenchmarkCase benchmarkCase;
+            benchmarkCase.values = generateTable(size, random);
+            runCase(benchmarkCase, repeatCount);
+            if (timeEdits) {
+                editCase.values = benchmarkCase.values;
+                runEdits(editCase, random);
+                editsSolved += editCase.solutionCount;
+            }
+
+            sizeLatencies.insert(sizeLatencies.end(), benchmarkCase.latencies.begin(), benchmarkCase.latencies.end());
+            sizeStats.nodes += benchmarkCase.stats.nodes;
+            sizeStats.branchPoints += benchmarkCase.stats.branchPoints;
+            sizeSolved += benchmarkCase.solutionCount;
+            addToTotal(benchmarkCase);
+        }
+        printResult("generated_" + std::to_string(size), size, sizeLatencies, sizeStats, sizeSolved, boardsPerSize);
+        if (timeEdits) {
+            printResult("edits_" + std::to_string(size), size, editCase.latencies, SearchStats(), editsSolved, boardsPerSize);
+        }
+    }
+
+    printResult("total", 0, allLatencies, allStats, allSolved, allPuzzles);
+    return allSolved == allPuzzles ? 0 : 2;
+}
@@ -0,0 +1,5147 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <cstdlib>
+#include <condition_variable>
+#include <functional>
+#include <charconv>
+#include <cstring>
+#include <random>
+#include <chrono>
+#include <list>
+#include <unordered_map>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "HitoriSat.h"
+
+// The bulk BitBoard operations run on vectors of words when the compiler
+// targets one of these instruction sets, e.g. with -mavx2 or /arch:AVX2.
+#if defined(__AVX2__)
+#define HITORI_SIMD_AVX2
+#elif defined(__SSE4_1__)
+#define HITORI_SIMD_SSE41
+#elif defined(__ARM_NEON)
+#define HITORI_SIMD_NEON
+#endif
+
+#if defined(HITORI_SIMD_AVX2) || defined(HITORI_SIMD_SSE41)
+#define HITORI_SIMD
+#include <immintrin.h>
+#elif defined(HITORI_SIMD_NEON)
+#define HITORI_SIMD
+#include <arm_neon.h>
+#endif
+
+// The detailed search counters cost a few clock reads per node, so they are
+// only compiled in with HITORI_ENABLE_STATS defined.
+#ifdef HITORI_ENABLE_STATS
+#define HITORI_STATS(...) __VA_ARGS__
+#else
+#define HITORI_STATS(...)
+#endif
+
+inline unsigned countBits(uint64_t bits) {
+#if defined(_MSC_VER) && defined(_M_X64)
+    return static_cast<unsigned>(__popcnt64(bits));
+#elif defined(_MSC_VER)
+    return __popcnt(static_cast<unsigned>(bits)) + __popcnt(static_cast<unsigned>(bits >> 32));
+#else
+    return static_cast<unsigned>(__builtin_popcountll(bits));
+#endif
+}
+
+inline unsigned lowestBit(uint64_t bits) {
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return static_cast<unsigned>(index);
+#elif defined(_MSC_VER)
+    unsigned long index;
+    if (_BitScanForward(&index, static_cast<unsigned long>(bits))) {
+        return static_cast<unsigned>(index);
+    }
+    _BitScanForward(&index, static_cast<unsigned long>(bits >> 32));
+    return static_cast<unsigned>(index) + 32;
+#else
+    return static_cast<unsigned>(__builtin_ctzll(bits));
+#endif
+}
+
+inline uint64_t clearBits(uint64_t bits, uint64_t mask) {
+    return bits & ~mask;
+}
+
+// The high word of the pair high:low shifted left by bitShift, of 0..64.
+inline uint64_t funnelShift(uint64_t high, uint64_t low, unsigned bitShift) {
+    if (bitShift == 0 || bitShift == 64) {
+        return bitShift == 0 ? high : low;
+    }
+    return high << bitShift | low >> (64 - bitShift);
+}
+
+#ifdef HITORI_SIMD
+// A vector of Lanes words with the operations BitBoard needs. The shifts
+// move every lane by the same count, and a count of 64 clears the lanes.
+struct WordVector {
+#if defined(HITORI_SIMD_AVX2)
+    static constexpr unsigned Lanes = 4;
+    __m256i v;
+
+    static WordVector load(const uint64_t *p) {
+        return { _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)) };
+    }
+
+    void store(uint64_t *p) const {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v);
+    }
+
+    bool isZero() const {
+        return _mm256_testz_si256(v, v) != 0;
+    }
+
+    friend WordVector operator&(const WordVector &a, const WordVector &b) {
+        return { _mm256_and_si256(a.v, b.v) };
+    }
+
+    friend WordVector operator|(const WordVector &a, const WordVector &b) {
+        return { _mm256_or_si256(a.v, b.v) };
+    }
+
+    friend WordVector operator^(const WordVector &a, const WordVector &b) {
+        return { _mm256_xor_si256(a.v, b.v) };
+    }
+
+    friend WordVector clearBits(const WordVector &bits, const WordVector &mask) {
+        return { _mm256_andnot_si256(mask.v, bits.v) };
+    }
+
+    WordVector shiftLeft(unsigned count) const {
+        return { _mm256_sll_epi64(v, _mm_cvtsi32_si128(static_cast<int>(count))) };
+    }
+
+    WordVector shiftRight(unsigned count) const {
+        return { _mm256_srl_epi64(v, _mm_cvtsi32_si128(static_cast<int>(count))) };
+    }
+#elif defined(HITORI_SIMD_SSE41)
+    static constexpr unsigned Lanes = 2;
+    __m128i v;
+
+    static WordVector load(const uint64_t *p) {
+        return { _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)) };
+    }
+
+    void store(uint64_t *p) const {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v);
+    }
+
+    bool isZero() const {
+        return _mm_testz_si128(v, v) != 0;
+    }
+
+    friend WordVector operator&(const WordVector &a, const WordVector &b) {
+        return { _mm_and_si128(a.v, b.v) };
+    }
+
+    friend WordVector operator|(const WordVector &a, const WordVector &b) {
+        return { _mm_or_si128(a.v, b.v) };
+    }
+
+    friend WordVector operator^(const WordVector &a, const WordVector &b) {
+        return { _mm_xor_si128(a.v, b.v) };
+    }
+
+    friend WordVector clearBits(const WordVector &bits, const WordVector &mask) {
+        return { _mm_andnot_si128(mask.v, bits.v) };
+    }
+
+    WordVector shiftLeft(unsigned count) const {
+        return { _mm_sll_epi64(v, _mm_cvtsi32_si128(static_cast<int>(count))) };
+    }
+
+    WordVector shiftRight(unsigned count) const {
+        return { _mm_srl_epi64(v, _mm_cvtsi32_si128(static_cast<int>(count))) };
+    }
+#else
+    static constexpr unsigned Lanes = 2;
+    uint64x2_t v;
+
+    static WordVector load(const uint64_t *p) {
+        return { vld1q_u64(p) };
+    }
+
+    void store(uint64_t *p) const {
+        vst1q_u64(p, v);
+    }
+
+    bool isZero() const {
+        return (vgetq_lane_u64(v, 0) | vgetq_lane_u64(v, 1)) == 0;
+    }
+
+    friend WordVector operator&(const WordVector &a, const WordVector &b) {
+        return { vandq_u64(a.v, b.v) };
+    }
+
+    friend WordVector operator|(const WordVector &a, const WordVector &b) {
+        return { vorrq_u64(a.v, b.v) };
+    }
+
+    friend WordVector operator^(const WordVector &a, const WordVector &b) {
+        return { veorq_u64(a.v, b.v) };
+    }
+
+    friend WordVector clearBits(const WordVector &bits, const WordVector &mask) {
+        return { vbicq_u64(bits.v, mask.v) };
+    }
+
+    WordVector shiftLeft(unsigned count) const {
+        return { vshlq_u64(v, vdupq_n_s64(static_cast<int64_t>(count))) };
+    }
+
+    WordVector shiftRight(unsigned count) const {
+        return { vshlq_u64(v, vdupq_n_s64(-static_cast<int64_t>(count))) };
+    }
+#endif
+};
+#endif
+
+template <unsigned Words>
+class BitBoard {
+private:
+    uint64_t words[Words];
+
+public:
+    static constexpr unsigned Capacity = Words * 64;
+
+    BitBoard():
+        words{} { }
+
+    bool test(unsigned i) const {
+        return (words[i >> 6] >> (i & 63)) & 1;
+    }
+
+    void set(unsigned i) {
+        words[i >> 6] |= uint64_t(1) << (i & 63);
+    }
+
+    void reset(unsigned i) {
+        words[i >> 6] &= ~(uint64_t(1) << (i & 63));
+    }
+
+    bool any() const {
+        auto w = 0U;
+#ifdef HITORI_SIMD
+        for (; w + WordVector::Lanes <= Words; w += WordVector::Lanes) {
+            if (!WordVector::load(words + w).isZero()) {
+                return true;
+            }
+        }
+#endif
+        for (; w < Words; w++) {
+            if (words[w] != 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    unsigned count() const {
+        auto result = 0U;
+        for (auto w = 0U; w < Words; w++) {
+            result += countBits(words[w]);
+        }
+        return result;
+    }
+
+    // Clears and returns the lowest set bit, the board must not be empty.
+    unsigned popLowest() {
+        auto w = 0U;
+        while (words[w] == 0) {
+            w++;
+        }
+        const auto i = w * 64 + lowestBit(words[w]);
+        words[w] &= words[w] - 1;
+        return i;
+    }
+
+    BitBoard &operator&=(const BitBoard &other) {
+        combine(other, [](const auto &a, const auto &b) {
+            return a & b;
+        });
+        return *this;
+    }
+
+    BitBoard &operator|=(const BitBoard &other) {
+        combine(other, [](const auto &a, const auto &b) {
+            return a | b;
+        });
+        return *this;
+    }
+
+    BitBoard &andNot(const BitBoard &other) {
+        combine(other, [](const auto &a, const auto &b) {
+            return clearBits(a, b);
+        });
+        return *this;
+    }
+
+    // Bits shifted past Capacity are dropped, bits shifted beyond the board
+    // have to be masked off by the caller.
+    BitBoard &operator<<=(unsigned shift) {
+        const auto wordShift = shift / 64;
+        const auto bitShift = shift % 64;
+        // Word w is made of the words w - wordShift and the one below, so the
+        // words are rewritten from the top down.
+        auto w = Words;
+#ifdef HITORI_SIMD
+        for (; w >= wordShift + 1 + WordVector::Lanes; w -= WordVector::Lanes) {
+            const auto first = w - WordVector::Lanes;
+            const auto bits = WordVector::load(words + first - wordShift).shiftLeft(bitShift) |
+                WordVector::load(words + first - wordShift - 1).shiftRight(64 - bitShift);
+            bits.store(words + first);
+        }
+#endif
+        while (w-- > 0) {
+            const auto high = w >= wordShift ? words[w - wordShift] : 0;
+            const auto low = w > wordShift ? words[w - wordShift - 1] : 0;
+            words[w] = funnelShift(high, low, bitShift);
+        }
+        return *this;
+    }
+
+    BitBoard &operator>>=(unsigned shift) {
+        const auto wordShift = shift / 64;
+        const auto bitShift = shift % 64;
+        auto w = 0U;
+#ifdef HITORI_SIMD
+        for (; w + wordShift + 1 + WordVector::Lanes <= Words; w += WordVector::Lanes) {
+            const auto bits = WordVector::load(words + w + wordShift).shiftRight(bitShift) |
+                WordVector::load(words + w + wordShift + 1).shiftLeft(64 - bitShift);
+            bits.store(words + w);
+        }
+#endif
+        for (; w < Words; w++) {
+            const auto high = w + wordShift + 1 < Words ? words[w + wordShift + 1] : 0;
+            const auto low = w + wordShift < Words ? words[w + wordShift] : 0;
+            words[w] = funnelShift(high, low, 64 - bitShift);
+        }
+        return *this;
+    }
+
+    BitBoard operator&(const BitBoard &other) const {
+        return BitBoard(*this) &= other;
+    }
+
+    BitBoard operator|(const BitBoard &other) const {
+        return BitBoard(*this) |= other;
+    }
+
+    BitBoard operator<<(unsigned shift) const {
+        return BitBoard(*this) <<= shift;
+    }
+
+    BitBoard operator>>(unsigned shift) const {
+        return BitBoard(*this) >>= shift;
+    }
+
+    bool operator==(const BitBoard &other) const {
+        auto w = 0U;
+#ifdef HITORI_SIMD
+        for (; w + WordVector::Lanes <= Words; w += WordVector::Lanes) {
+            if (!(WordVector::load(words + w) ^ WordVector::load(other.words + w)).isZero()) {
+                return false;
+            }
+        }
+#endif
+        for (; w < Words; w++) {
+            if (words[w] != other.words[w]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool operator!=(const BitBoard &other) const {
+        return !(*this == other);
+    }
+
+private:
+    // Sets every word to op of it and the word of other, op is called with
+    // either words or WordVectors.
+    template <typename Op>
+    void combine(const BitBoard &other, Op op) {
+        auto w = 0U;
+#ifdef HITORI_SIMD
+        for (; w + WordVector::Lanes <= Words; w += WordVector::Lanes) {
+            op(WordVector::load(words + w), WordVector::load(other.words + w)).store(words + w);
+        }
+#endif
+        for (; w < Words; w++) {
+            words[w] = op(words[w], other.words[w]);
+        }
+    }
+};
+
+// Elements are 0 to size - 1. A set's root has the parent -1 - rank.
+class DisjointSets {
+private:
+    std::vector<int> parents;
+    std::vector<std::pair<unsigned, int>> history;
+
+public:
+    DisjointSets(unsigned size) {
+        reset(size);
+    }
+
+    // Makes every element a set of its own again, keeping the storage.
+    void reset(unsigned size) {
+        parents.assign(size, -1);
+        history.clear();
+        history.reserve(2 * size);
+    }
+
+    unsigned findSet(unsigned e) const {
+        assertElementRange(e);
+
+        while (parents[e] >= 0) {
+            e = static_cast<unsigned>(parents[e]);
+        }
+
+        return e;
+    }
+
+    void unionSets(unsigned e1, unsigned e2) {
+        const auto root1 = findSet(e1);
+        const auto root2 = findSet(e2);
+        linkSets(root1, root2);
+    }
+
+    void linkSets(unsigned set1, unsigned set2) {
+        assertElementRange(set1);
+        assertElementRange(set2);
+
+        if (parents[set1] >= 0 || parents[set2] >= 0) {
+            throw std::logic_error("at least one element is not root");
+        }
+
+        if (set1 != set2) {
+            const auto rank1 = -parents[set1] - 1;
+            const auto rank2 = -parents[set2] - 1;
+            if (rank1 < rank2) {
+                setParent(set1, static_cast<int>(set2));
+
+            } else if (rank2 < rank1) {
+                setParent(set2, static_cast<int>(set1));
+
+            } else {
+                setParent(set1, static_cast<int>(set2));
+                setParent(set2, parents[set2] - 1);
+            }
+        }
+    }
+
+    size_t getHistorySize() const {
+        return history.size();
+    }
+
+    void rollback(size_t historySize) {
+        while (history.size() > historySize) {
+            const auto &entry = history.back();
+            parents[entry.first] = entry.second;
+            history.pop_back();
+        }
+    }
+
+private:
+    // There is no path compression in findSet, so every change of the
+    // parents array goes through here and can be undone by rollback.
+    void setParent(unsigned e, int parent) {
+        history.emplace_back(e, parents[e]);
+        parents[e] = parent;
+    }
+
+    void assertElementRange(unsigned e) const {
+        if (e >= parents.size()) {
+            throw std::range_error("element index is out of range");
+        }
+    }
+};
+
+// The values of a size x size table, row by row.
+struct TableValues {
+    unsigned size = 0;
+    std::vector<unsigned> values;
+};
+
+class TableBase {
+public:
+    class Cell {
+    public:
+        enum class State : uint8_t {
+            Unknown,
+            Final,
+            Deleted
+        };
+
+    private:
+        unsigned value;
+        State state;
+
+    public:
+        Cell(unsigned value, State state):
+            value(value),
+            state(state) { }
+
+        unsigned getValue() const {
+            return value;
+        }
+
+        State getState() const {
+            return state;
+        }
+    };
+
+    class InvalidShapeException: public std::length_error {
+    public:
+        InvalidShapeException():
+            std::length_error("table shape is invalid") { }
+    };
+
+    class InvalidValueException : public std::range_error {
+    public:
+        InvalidValueException():
+            std::range_error("invalid value") { }
+    };
+
+    class MultipleStateChangeException : public std::logic_error {
+    public:
+        MultipleStateChangeException():
+            std::logic_error("tried to set an entry's state multiple times") { }
+    };
+
+    // Returned by the state changing operations, anything but None means
+    // that the table has no solution from its current state.
+    enum class Conflict : uint8_t {
+        None,
+        DeletedNeighbor,
+        CircularNeighbors,
+        MultipleFinalizedInRow,
+        MultipleFinalizedInColumn,
+        // A deduction rule required a state the cell doesn't have.
+        ForcedStateMismatch,
+        // Every cell of a nogood the search learned has its state.
+        LearnedNogood
+    };
+
+    static constexpr unsigned ConflictCount = static_cast<unsigned>(Conflict::LearnedNogood) + 1;
+
+    static const char *getConflictName(Conflict conflict) {
+        switch (conflict) {
+        case Conflict::None:
+            return "none";
+
+        case Conflict::DeletedNeighbor:
+            return "deleted neighbor";
+
+        case Conflict::CircularNeighbors:
+            return "circular neighbors";
+
+        case Conflict::MultipleFinalizedInRow:
+            return "multiple finalized in row";
+
+        case Conflict::MultipleFinalizedInColumn:
+            return "multiple finalized in column";
+
+        case Conflict::ForcedStateMismatch:
+            return "forced state mismatch";
+
+        case Conflict::LearnedNogood:
+            return "learned nogood";
+        }
+        return "unknown";
+    }
+
+    struct Checkpoint {
+        size_t trailSize;
+        size_t deletedTreesHistorySize;
+    };
+
+    // Tables store values in uint16_t cells, but the corpus format and the
+    // solve cache keep a board's size and values in bytes.
+    static constexpr unsigned MaxSize = 255;
+
+    static constexpr unsigned getMaxSize(unsigned words) {
+        auto size = 0U;
+        while (size < MaxSize && (size + 1) * (size + 1) <= words * 64) {
+            size++;
+        }
+        return size;
+    }
+};
+
+// The board size of a Table. The sizes the engine is specialised for make
+// it a constant, so loop bounds and r * size + c indices fold; 0 keeps it
+// in a member set by the table.
+template <unsigned FixedSize>
+struct TableDimension {
+    static constexpr unsigned size = FixedSize;
+
+    void setSize(unsigned) { }
+};
+
+template <>
+struct TableDimension<0> {
+    unsigned size = 0;
+
+    void setSize(unsigned newSize) {
+        size = newSize;
+    }
+};
+
+// Cell states are kept in two bit planes of a BitBoard<Words>, so the
+// engine is instantiated for a few board capacities, and for some common
+// board sizes; see visitTableType. A table with a nonzero TableSize only
+// takes boards of that size.
+template <unsigned TableWords, unsigned TableSize = 0>
+class Table : public TableBase, private TableDimension<TableSize> {
+public:
+    class Row {
+    public:
+        class Iterator {
+        private:
+            const Table *table;
+            unsigned pos;
+
+        public:
+            Iterator(const Table *table, unsigned pos):
+                table(table),
+                pos(pos) { }
+
+            Cell operator*() const {
+                return Cell(table->values[pos], table->getState(pos));
+            }
+
+            Iterator &operator++() {
+                pos++;
+                return *this;
+            }
+
+            bool operator!=(const Iterator &other) const {
+                return pos != other.pos;
+            }
+        };
+
+    private:
+        const Table *table;
+        unsigned row;
+
+    public:
+        Row(const Table *table, unsigned row):
+            table(table),
+            row(row) { }
+
+        Iterator begin() const {
+            return Iterator(table, row * table->size);
+        }
+
+        Iterator end() const {
+            return Iterator(table, (row + 1) * table->size);
+        }
+    };
+
+    class RowIterator {
+    private:
+        const Table *table;
+        unsigned row;
+
+    public:
+        RowIterator(const Table *table, unsigned row):
+            table(table),
+            row(row) { }
+
+        Row operator*() const {
+            return Row(table, row);
+        }
+
+        RowIterator &operator++() {
+            row++;
+            return *this;
+        }
+
+        bool operator!=(const RowIterator &other) const {
+            return row != other.row;
+        }
+    };
+
+    static constexpr unsigned Words = TableWords;
+    static constexpr unsigned Capacity = getMaxSize(Words);
+    static constexpr unsigned FixedSize = TableSize;
+
+    static_assert(FixedSize <= Capacity, "The fixed size doesn't fit the table");
+
+private:
+    using State = Cell::State;
+    using Mask = BitBoard<Words>;
+    using Dimension = TableDimension<TableSize>;
+
+    using Dimension::size;
+    // Per-cell data is indexed by r * size + c. The copies of a value in a
+    // line form a group, numbered line by line; a cell's row and column
+    // group index the counts of their unknown copies. The storage grows with
+    // the cells, not with the values a line could hold.
+    std::vector<uint16_t> values;
+    std::vector<unsigned> rowGroups, columnGroups;
+    std::vector<uint16_t> rowCounts, columnCounts;
+    // The columns of the copies of every row group, in order, from
+    // rowGroupStarts[group] to rowGroupStarts[group + 1]; and the rows of
+    // the column groups. These don't change during the search.
+    std::vector<unsigned> rowGroupStarts, columnGroupStarts;
+    std::vector<uint16_t> rowGroupMembers, columnGroupMembers;
+    // The cell states again, on a grid with a ring of sentinel cells around
+    // the board, indexed by (r + 1) * (size + 2) + c + 1. The neighbors of a
+    // cell are read without range checks; and the deleted trees use these
+    // indices, with the corner sentinel 0 standing for the border.
+    static constexpr uint8_t Sentinel = 3;
+    std::vector<uint8_t> paddedStates;
+    // The group of each value in the line being grouped, scratch of reset.
+    std::vector<unsigned> valueGroups;
+    // Cells of the board, and the cells off the first/last column and on
+    // the border, used to mask the ends of the rows when shifting.
+    Mask boardCells, notFirstColumnCells, notLastColumnCells, borderCells;
+    Mask finalCells, deletedCells;
+    unsigned unknownCellCount;
+    unsigned deletedCellCount;
+    DisjointSets deletedTrees;
+    std::vector<unsigned> trail;
+    // Unknown cells are bucketed by their conflict degree, the number of
+    // other unknown cells with the same value in their row and column.
+    // Every bucket is a doubly linked list threaded through the cells.
+    static constexpr unsigned NoCell = ~0U;
+    std::vector<uint16_t> conflictDegrees;
+    std::vector<unsigned> degreeBuckets;
+    std::vector<unsigned> nextInBucket, prevInBucket;
+    unsigned maxConflictDegree;
+    // Where the last conflict was found, see getConflictPos.
+    unsigned conflictPos;
+    unsigned conflictOtherPos;
+#ifdef HITORI_ENABLE_STATS
+    // Calls of finalizeCell and deleteCell, the nested ones included. They
+    // aren't part of the state, rollback leaves them alone.
+    unsigned long long finalizeCallCount = 0;
+    unsigned long long deleteCallCount = 0;
+#endif
+
+public:
+    // An empty table, to be reset to a board before use.
+    Table():
+        unknownCellCount(0),
+        deletedCellCount(0),
+        deletedTrees(1),
+        maxConflictDegree(0),
+        conflictPos(NoCell),
+        conflictOtherPos(NoCell) { }
+
+    Table(const TableValues &initValues):
+        Table() {
+
+        reset(initValues);
+    }
+
+    // Sets the table up for a new board. The storage of the previous board
+    // is reused, so resetting to a board no bigger than an earlier one
+    // doesn't allocate. The table is unusable if this throws.
+    void reset(const TableValues &initValues) {
+        if (initValues.size > Capacity || initValues.values.size() != initValues.size * initValues.size ||
+            (FixedSize != 0 && initValues.size != FixedSize)) {
+            throw InvalidShapeException();
+        }
+
+        Dimension::setSize(initValues.size);
+        unknownCellCount = size * size;
+        deletedCellCount = 0;
+        const auto width = size + 2;
+        deletedTrees.reset(width * width);
+        paddedStates.assign(width * width, Sentinel);
+
+        values.clear();
+        values.reserve(size * size);
+        boardCells = Mask();
+        notFirstColumnCells = Mask();
+        notLastColumnCells = Mask();
+        borderCells = Mask();
+        finalCells = Mask();
+        deletedCells = Mask();
+
+        for (auto actRow = 0U; actRow < size; actRow++) {
+            for (auto actColumn = 0U; actColumn < size; actColumn++) {
+                const auto value = initValues.values[actRow * size + actColumn];
+                if (value == 0 || value > size) {
+                    throw InvalidValueException();
+                }
+                values.push_back(static_cast<uint16_t>(value));
+
+                const auto pos = actRow * size + actColumn;
+                paddedStates[getPaddedPos(pos)] = static_cast<uint8_t>(State::Unknown);
+                boardCells.set(pos);
+                if (actColumn != 0) {
+                    notFirstColumnCells.set(pos);
+                }
+                if (actColumn != size - 1) {
+                    notLastColumnCells.set(pos);
+                }
+                if (isOnBorder(actRow, actColumn)) {
+                    borderCells.set(pos);
+                }
+            }
+        }
+
+        groupLines(size, 1, rowGroups, rowCounts, rowGroupStarts, rowGroupMembers);
+        groupLines(1, size, columnGroups, columnCounts, columnGroupStarts, columnGroupMembers);
+
+        trail.clear();
+        trail.reserve(size * size);
+
+        conflictDegrees.resize(size * size);
+        degreeBuckets.assign(2 * size - 1, NoCell);
+        nextInBucket.resize(size * size);
+        prevInBucket.resize(size * size);
+        maxConflictDegree = 0;
+        for (auto pos = size * size; pos-- > 0;) {
+            insertIntoBucket(pos, getUnknownPeerCount(pos));
+        }
+    }
+
+    unsigned getSize() const {
+        return size;
+    }
+
+    Cell getCell(unsigned row, unsigned column) const {
+        const auto pos = row * size + column;
+        return Cell(values[pos], getState(pos));
+    }
+
+    RowIterator begin() const {
+        return RowIterator(this, 0);
+    }
+
+    RowIterator end() const {
+        return RowIterator(this, size);
+    }
+
+    bool isSolved() const {
+        return unknownCellCount == 0;
+    }
+
+    // Whether every deleted cell has a final copy of its value in its row
+    // or column. Of the solutions, these are the minimal ones: in any other
+    // solution, some deleted cell could be kept final as well.
+    bool isMinimal() const {
+        auto cells = deletedCells;
+        while (cells.any()) {
+            if (!hasFinalCopy(cells.popLowest())) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    Checkpoint getCheckpoint() const {
+        return { trail.size(), deletedTrees.getHistorySize() };
+    }
+
+    void rollback(const Checkpoint &checkpoint) {
+        while (trail.size() > checkpoint.trailSize) {
+            const auto pos = trail.back();
+            trail.pop_back();
+
+            if (deletedCells.test(pos)) {
+                deletedCells.reset(pos);
+                deletedCellCount--;
+            }
+            finalCells.reset(pos);
+            paddedStates[getPaddedPos(pos)] = static_cast<uint8_t>(State::Unknown);
+
+            rowCounts[rowGroups[pos]]++;
+            columnCounts[columnGroups[pos]]++;
+            unknownCellCount++;
+
+            updatePeerDegrees(pos, 1);
+            insertIntoBucket(pos, getUnknownPeerCount(pos));
+        }
+
+        deletedTrees.rollback(checkpoint.deletedTreesHistorySize);
+    }
+
+    // The cells in the order their states were set, as r * size + c.
+    size_t getTrailSize() const {
+        return trail.size();
+    }
+
+    unsigned getTrailPos(size_t index) const {
+        return trail[index];
+    }
+
+    State getState(unsigned pos) const {
+        if (deletedCells.test(pos)) {
+            return State::Deleted;
+        }
+        return finalCells.test(pos) ? State::Final : State::Unknown;
+    }
+
+    // The cell the last conflict of a state change was found at, as
+    // r * size + c, and the other cell involved: the final copy of the value
+    // for MultipleFinalizedInRow/Column, with the cell final, and the
+    // deleted neighbor for DeletedNeighbor, with the cell left unknown like
+    // for CircularNeighbors. For conflict analysis, see NogoodLearner.
+    unsigned getConflictPos() const {
+        return conflictPos;
+    }
+
+    unsigned getConflictOtherPos() const {
+        return conflictOtherPos;
+    }
+
+    // Calls onCell(row, column) for the cells whose state was set since the
+    // checkpoint, in the order they were set.
+    template <typename OnCell>
+    void forEachChangeSince(const Checkpoint &checkpoint, OnCell &&onCell) const {
+        for (auto i = checkpoint.trailSize; i < trail.size(); i++) {
+            onCell(trail[i] / size, trail[i] % size);
+        }
+    }
+
+    // The cells of degree 0 are the only ones with their value among the
+    // unknown cells of their lines. As the same value can't be final in a
+    // line that still has an unknown copy, they don't need propagation.
+    void finalizeUniqueCells() {
+        while (degreeBuckets[0] != NoCell) {
+            setCellState(degreeBuckets[0], State::Final);
+        }
+    }
+
+#ifdef HITORI_ENABLE_STATS
+    unsigned long long getFinalizeCallCount() const {
+        return finalizeCallCount;
+    }
+
+    unsigned long long getDeleteCallCount() const {
+        return deleteCallCount;
+    }
+#endif
+
+    Conflict finalizeCell(unsigned row, unsigned column) {
+        HITORI_STATS(finalizeCallCount++);
+        const auto pos = row * size + column;
+        if (getState(pos) != State::Unknown) {
+            throw MultipleStateChangeException();
+        }
+        setCellState(pos, State::Final);
+
+        // The scans can't be skipped when no unknown copies of the value are
+        // left: a nested deleteCell may have finalized another copy already.
+        const auto columnGroup = columnGroups[pos];
+        for (auto i = columnGroupStarts[columnGroup]; i < columnGroupStarts[columnGroup + 1]; i++) {
+            const unsigned r = columnGroupMembers[i];
+            if (r == row) {
+                continue;
+            }
+            switch (getState(r * size + column)) {
+            case State::Final:
+                conflictPos = pos;
+                conflictOtherPos = r * size + column;
+                return Conflict::MultipleFinalizedInColumn;
+
+            case State::Unknown: {
+                const auto conflict = deleteCell(r, column);
+                if (conflict != Conflict::None) {
+                    return conflict;
+                }
+                break;
+            }
+
+            case State::Deleted:
+                break;
+            }
+        }
+
+        const auto rowGroup = rowGroups[pos];
+        for (auto i = rowGroupStarts[rowGroup]; i < rowGroupStarts[rowGroup + 1]; i++) {
+            const unsigned c = rowGroupMembers[i];
+            if (c == column) {
+                continue;
+            }
+            switch (getState(row * size + c)) {
+            case State::Final:
+                conflictPos = pos;
+                conflictOtherPos = row * size + c;
+                return Conflict::MultipleFinalizedInRow;
+
+            case State::Unknown: {
+                const auto conflict = deleteCell(row, c);
+                if (conflict != Conflict::None) {
+                    return conflict;
+                }
+                break;
+            }
+
+            case State::Deleted:
+                break;
+            }
+        }
+
+        return Conflict::None;
+    }
+
+    Conflict deleteCell(unsigned row, unsigned column) {
+        HITORI_STATS(deleteCallCount++);
+        const auto pos = row * size + column;
+        if (getState(pos) != State::Unknown) {
+            throw MultipleStateChangeException();
+        }
+
+        // Single cell neighborhoods are read from the padded grid, building
+        // masks for them would touch every word of the board. The neighbors
+        // are right, up, left and down; the sentinels are never deleted.
+        const auto paddedPos = getPaddedPos(pos);
+        const int paddedOffsets[4] = { 1, -static_cast<int>(size + 2), -1, static_cast<int>(size + 2) };
+        const int offsets[4] = { 1, -static_cast<int>(size), -1, static_cast<int>(size) };
+        for (auto i = 0U; i < 4; i++) {
+            if (paddedStates[paddedPos + paddedOffsets[i]] == static_cast<uint8_t>(State::Deleted)) {
+                conflictPos = pos;
+                conflictOtherPos = static_cast<unsigned>(static_cast<int>(pos) + offsets[i]);
+                return Conflict::DeletedNeighbor;
+            }
+        }
+
+        unsigned adjacentTrees[5];
+        const auto adjacentTreeCount = getAdjacentDeletedTrees(row, column, adjacentTrees);
+        if (adjacentTreeCount < 0) {
+            conflictPos = pos;
+            conflictOtherPos = NoCell;
+            return Conflict::CircularNeighbors;
+        }
+
+        for (auto i = 0; i < adjacentTreeCount; i++) {
+            deletedTrees.linkSets(adjacentTrees[i], deletedTrees.findSet(paddedPos));
+        }
+
+        setCellState(pos, State::Deleted);
+
+        for (auto i = 0U; i < 4; i++) {
+            if (paddedStates[paddedPos + paddedOffsets[i]] == static_cast<uint8_t>(State::Unknown)) {
+                const auto neighborPos = static_cast<unsigned>(static_cast<int>(pos) + offsets[i]);
+                const auto conflict = finalizeCell(neighborPos / size, neighborPos % size);
+                if (conflict != Conflict::None) {
+                    return conflict;
+                }
+            }
+        }
+
+        return Conflict::None;
+    }
+
+    // Applies the deductions that only depend on the values, so they are
+    // needed once per table before the search:
+    // - sandwich: in X?X the middle cell is final
+    // - pair: if XX are adjacent in a line, one of them is final and every
+    //   other X of the line is deleted
+    // - corner: if the corner equals both of its neighbors, or the corner
+    //   block is made of two parallel pairs, the corner is deleted; in the
+    //   latter case the diagonally opposite cell of the block as well
+    Conflict applyPatterns() {
+        for (auto line = 0U; line < size; line++) {
+            auto conflict = applyLinePatterns(line * size, 1);
+            if (conflict == Conflict::None) {
+                conflict = applyLinePatterns(line, size);
+            }
+            if (conflict != Conflict::None) {
+                return conflict;
+            }
+        }
+
+        if (size < 2) {
+            return Conflict::None;
+        }
+
+        const unsigned corners[4][2] = { { 0, 0 }, { 0, size - 1 }, { size - 1, 0 }, { size - 1, size - 1 } };
+        for (const auto &corner : corners) {
+            const auto row = corner[0];
+            const auto column = corner[1];
+            const auto cornerPos = row * size + column;
+            const auto rowNeighborPos = row * size + (column == 0 ? 1 : size - 2);
+            const auto columnNeighborPos = (row == 0 ? 1 : size - 2) * size + column;
+            const auto oppositePos = columnNeighborPos + rowNeighborPos - cornerPos;
+
+            const auto cornerValue = values[cornerPos];
+            const auto rowPair = values[rowNeighborPos] == cornerValue && values[columnNeighborPos] == values[oppositePos];
+            const auto columnPair = values[columnNeighborPos] == cornerValue && values[rowNeighborPos] == values[oppositePos];
+
+            auto conflict = Conflict::None;
+            if (rowPair || columnPair) {
+                conflict = requireState(cornerPos, State::Deleted);
+                if (conflict == Conflict::None) {
+                    conflict = requireState(oppositePos, State::Deleted);
+                }
+
+            } else if (values[rowNeighborPos] == cornerValue && values[columnNeighborPos] == cornerValue) {
+                conflict = requireState(cornerPos, State::Deleted);
+            }
+            if (conflict != Conflict::None) {
+                return conflict;
+            }
+        }
+
+        return Conflict::None;
+    }
+
+    // Runs the state dependent deductions to a fixpoint: unique cells are
+    // finalized, and so are the unknown cells whose deletion would split
+    // the remaining cells in two. The cut cells only change when cells get
+    // deleted, so they are looked for again only after a deletion.
+    Conflict propagate() {
+        auto lastUnknownCellCount = 0U;
+        auto lastDeletedCellCount = ~0U;
+        while (!isSolved() && unknownCellCount != lastUnknownCellCount) {
+            finalizeUniqueCells();
+            lastUnknownCellCount = unknownCellCount;
+            if (deletedCellCount == lastDeletedCellCount) {
+                continue;
+            }
+            lastDeletedCellCount = deletedCellCount;
+
+            auto cutCells = findCutCells();
+            while (cutCells.any()) {
+                const auto pos = cutCells.popLowest();
+                if (getState(pos) == State::Unknown) {
+                    const auto conflict = finalizeCell(pos / size, pos % size);
+                    if (conflict != Conflict::None) {
+                        return conflict;
+                    }
+                }
+            }
+        }
+
+        return Conflict::None;
+    }
+
+    // Branches on the unknown cell with the most unknown copies of its value
+    // in its row and column.
+    auto getFinalizeCandidatePos() const {
+        const auto pos = degreeBuckets[maxConflictDegree];
+        return std::make_pair(pos / size, pos % size);
+    }
+
+private:
+    Conflict applyLinePatterns(unsigned first, unsigned step) {
+        const auto &groups = step == 1 ? rowGroups : columnGroups;
+        const auto &groupStarts = step == 1 ? rowGroupStarts : columnGroupStarts;
+        const auto &groupMembers = step == 1 ? rowGroupMembers : columnGroupMembers;
+
+        for (auto i = 0U; i + 1 < size; i++) {
+            const auto pos = first + i * step;
+            const auto value = values[pos];
+
+            if (i + 2 < size && values[pos + 2 * step] == value && values[pos + step] != value) {
+                const auto conflict = requireState(pos + step, State::Final);
+                if (conflict != Conflict::None) {
+                    return conflict;
+                }
+            }
+
+            if (values[pos + step] == value) {
+                const auto group = groups[pos];
+                for (auto k = groupStarts[group]; k < groupStarts[group + 1]; k++) {
+                    const unsigned other = groupMembers[k];
+                    if (other == i || other == i + 1) {
+                        continue;
+                    }
+                    const auto conflict = requireState(first + other * step, State::Deleted);
+                    if (conflict != Conflict::None) {
+                        return conflict;
+                    }
+                }
+            }
+        }
+
+        return Conflict::None;
+    }
+
+    Conflict requireState(unsigned pos, State state) {
+        const auto actState = getState(pos);
+        if (actState == State::Unknown) {
+            return state == State::Final ? finalizeCell(pos / size, pos % size) : deleteCell(pos / size, pos % size);
+        }
+        return actState == state ? Conflict::None : Conflict::ForcedStateMismatch;
+    }
+
+    // The non-deleted cells stay connected as long as the deleted cells,
+    // joined diagonally and through a virtual node for the border, form a
+    // forest: a loop in it is exactly what encloses a group of cells. The
+    // forest is kept in deletedTrees by padded position, node 0 stands for
+    // the border.
+    //
+    // Collects the distinct trees a deletion at row, column would join.
+    // Returns -1 if two of them are the same, i.e. the deletion would close
+    // a loop and disconnect the remaining cells.
+    int getAdjacentDeletedTrees(unsigned row, unsigned column, unsigned (&trees)[5]) const {
+        auto treeCount = 0;
+        const auto addTree = [&](unsigned tree) {
+            for (auto i = 0; i < treeCount; i++) {
+                if (trees[i] == tree) {
+                    return false;
+                }
+            }
+            trees[treeCount++] = tree;
+            return true;
+        };
+
+        if (isOnBorder(row, column)) {
+            addTree(deletedTrees.findSet(0));
+        }
+
+        const auto paddedPos = getPaddedPos(row * size + column);
+        const auto width = static_cast<int>(size + 2);
+        const int offsets[4] = { -width - 1, -width + 1, width + 1, width - 1 };
+        for (const auto offset : offsets) {
+            const auto neighbor = paddedPos + offset;
+            if (paddedStates[neighbor] == static_cast<uint8_t>(State::Deleted) && !addTree(deletedTrees.findSet(neighbor))) {
+                return -1;
+            }
+        }
+
+        return treeCount;
+    }
+
+    // Returns the unknown cells whose deletion would close a loop of deleted
+    // cells. Deleting one of them would cut off a neighbor that deleteCell
+    // finalizes, so they all have to be final. Only the cells touching two
+    // deleted cells diagonally, or one from the border, can close a loop,
+    // and these are found with a few shifts of the deleted cells.
+    Mask findCutCells() const {
+        const auto deletedLeft = deletedCells & notLastColumnCells;
+        const auto deletedRight = deletedCells & notFirstColumnCells;
+        const Mask diagonals[4] = {
+            deletedLeft << (size + 1),
+            deletedRight << (size - 1),
+            deletedRight >> (size + 1),
+            deletedLeft >> (size - 1)
+        };
+
+        Mask once, twice;
+        for (const auto &diagonal : diagonals) {
+            twice |= once & diagonal;
+            once |= diagonal;
+        }
+
+        auto candidates = (twice | (once & borderCells)) & boardCells;
+        candidates.andNot(finalCells | deletedCells);
+
+        Mask cutCells;
+        unsigned trees[5];
+        while (candidates.any()) {
+            const auto pos = candidates.popLowest();
+            if (getAdjacentDeletedTrees(pos / size, pos % size, trees) < 0) {
+                cutCells.set(pos);
+            }
+        }
+
+        return cutCells;
+    }
+
+    bool isOnBorder(unsigned row, unsigned column) const {
+        return row == 0 || row == size - 1 || column == 0 || column == size - 1;
+    }
+
+    bool hasFinalCopy(unsigned pos) const {
+        const auto row = pos / size;
+        const auto column = pos % size;
+        const auto rowGroup = rowGroups[pos];
+        for (auto i = rowGroupStarts[rowGroup]; i < rowGroupStarts[rowGroup + 1]; i++) {
+            if (getState(row * size + rowGroupMembers[i]) == State::Final) {
+                return true;
+            }
+        }
+        const auto columnGroup = columnGroups[pos];
+        for (auto i = columnGroupStarts[columnGroup]; i < columnGroupStarts[columnGroup + 1]; i++) {
+            if (getState(columnGroupMembers[i] * size + column) == State::Final) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // (r + 1) * (size + 2) + c + 1 for the cell r * size + c.
+    unsigned getPaddedPos(unsigned pos) const {
+        return pos + 2 * (pos / size) + size + 3;
+    }
+
+    // Numbers the groups of copies line by line, the cells of a line being
+    // line * lineStep + i * step, and lists their members by i.
+    void groupLines(unsigned lineStep, unsigned step, std::vector<unsigned> &groups, std::vector<uint16_t> &counts,
+                    std::vector<unsigned> &groupStarts, std::vector<uint16_t> &groupMembers) {
+        groups.resize(size * size);
+        counts.clear();
+        valueGroups.assign(size + 1, NoCell);
+        for (auto line = 0U; line < size; line++) {
+            for (auto i = 0U; i < size; i++) {
+                const auto pos = line * lineStep + i * step;
+                auto &group = valueGroups[values[pos]];
+                if (group == NoCell) {
+                    group = static_cast<unsigned>(counts.size());
+                    counts.push_back(0);
+                }
+                groups[pos] = group;
+                counts[group]++;
+            }
+            for (auto i = 0U; i < size; i++) {
+                valueGroups[values[line * lineStep + i * step]] = NoCell;
+            }
+        }
+
+        // The starts double as the fill cursors, then are shifted back.
+        groupStarts.assign(counts.size() + 1, 0);
+        for (auto group = 0U; group < counts.size(); group++) {
+            groupStarts[group + 1] = groupStarts[group] + counts[group];
+        }
+        groupMembers.resize(size * size);
+        for (auto line = 0U; line < size; line++) {
+            for (auto i = 0U; i < size; i++) {
+                groupMembers[groupStarts[groups[line * lineStep + i * step]]++] = static_cast<uint16_t>(i);
+            }
+        }
+        for (auto group = static_cast<unsigned>(counts.size()); group > 0; group--) {
+            groupStarts[group] = groupStarts[group - 1];
+        }
+        groupStarts[0] = 0;
+    }
+
+    void setCellState(unsigned pos, State state) {
+        if (state == State::Final) {
+            finalCells.set(pos);
+        } else {
+            deletedCells.set(pos);
+            deletedCellCount++;
+        }
+
+        paddedStates[getPaddedPos(pos)] = static_cast<uint8_t>(state);
+        rowCounts[rowGroups[pos]]--;
+        columnCounts[columnGroups[pos]]--;
+        unknownCellCount--;
+
+        removeFromBucket(pos);
+        updatePeerDegrees(pos, -1);
+
+        trail.push_back(pos);
+    }
+
+    unsigned getUnknownPeerCount(unsigned pos) const {
+        return rowCounts[rowGroups[pos]] + columnCounts[columnGroups[pos]] - 2;
+    }
+
+    void updatePeerDegrees(unsigned pos, int delta) {
+        const auto row = pos / size;
+        const auto column = pos % size;
+
+        const auto columnGroup = columnGroups[pos];
+        for (auto i = columnGroupStarts[columnGroup]; i < columnGroupStarts[columnGroup + 1]; i++) {
+            const auto peerPos = columnGroupMembers[i] * size + column;
+            if (peerPos != pos && getState(peerPos) == State::Unknown) {
+                changeDegree(peerPos, delta);
+            }
+        }
+
+        const auto rowGroup = rowGroups[pos];
+        for (auto i = rowGroupStarts[rowGroup]; i < rowGroupStarts[rowGroup + 1]; i++) {
+            const auto peerPos = row * size + rowGroupMembers[i];
+            if (peerPos != pos && getState(peerPos) == State::Unknown) {
+                changeDegree(peerPos, delta);
+            }
+        }
+    }
+
+    void changeDegree(unsigned pos, int delta) {
+        removeFromBucket(pos);
+        insertIntoBucket(pos, conflictDegrees[pos] + delta);
+    }
+
+    void insertIntoBucket(unsigned pos, unsigned degree) {
+        conflictDegrees[pos] = static_cast<uint16_t>(degree);
+
+        const auto head = degreeBuckets[degree];
+        nextInBucket[pos] = head;
+        prevInBucket[pos] = NoCell;
+        if (head != NoCell) {
+            prevInBucket[head] = pos;
+        }
+        degreeBuckets[degree] = pos;
+
+        if (degree > maxConflictDegree) {
+            maxConflictDegree = degree;
+        }
+    }
+
+    void removeFromBucket(unsigned pos) {
+        const auto next = nextInBucket[pos];
+        const auto prev = prevInBucket[pos];
+        if (next != NoCell) {
+            prevInBucket[next] = prev;
+        }
+        if (prev != NoCell) {
+            nextInBucket[prev] = next;
+        } else {
+            degreeBuckets[conflictDegrees[pos]] = next;
+        }
+
+        while (maxConflictDegree > 0 && degreeBuckets[maxConflictDegree] == NoCell) {
+            maxConflictDegree--;
+        }
+    }
+};
+
+template <unsigned Words, unsigned Size>
+constexpr unsigned Table<Words, Size>::NoCell;
+
+// Renders tables as text in one pass, appending to a string that is then
+// handed to the stream in a single write.
+class TableFormatter {
+public:
+    enum class Style {
+        // The board, one row per line, values right aligned.
+        Grid,
+        // The board on one line, rows separated by '/'.
+        Compact,
+        // One line of 0 (kept) and 1 (deleted) per cell, rows separated by '/'.
+        Mask
+    };
+
+    template <unsigned Words, unsigned Size>
+    static void append(std::string &out, const Table<Words, Size> &t, Style style) {
+        appendCells(out, t.getSize(), style, [&](unsigned row, unsigned column) {
+            return t.getCell(row, column);
+        });
+    }
+
+    // A solved board given by its values and its deleted cells, one nonzero
+    // byte per deleted cell.
+    static void append(std::string &out, const TableValues &values, const std::vector<uint8_t> &deleted, Style style) {
+        appendCells(out, values.size, style, [&](unsigned row, unsigned column) {
+            const auto pos = row * values.size + column;
+            const auto state = deleted[pos] != 0 ? TableBase::Cell::State::Deleted : TableBase::Cell::State::Final;
+            return TableBase::Cell(values.values[pos], state);
+        });
+    }
+
+    // A board given by its values and the states of its cells.
+    static void append(std::string &out, const TableValues &values, const std::vector<TableBase::Cell::State> &states, Style style) {
+        appendCells(out, values.size, style, [&](unsigned row, unsigned column) {
+            const auto pos = row * values.size + column;
+            return TableBase::Cell(values.values[pos], states[pos]);
+        });
+    }
+
+    // The values of a board in the layout TableReader reads, as a grid.
+    static void append(std::string &out, const TableValues &values) {
+        const auto digits = getDigitCount(values.size);
+        for (auto pos = 0U; pos < values.values.size(); pos++) {
+            char text[16];
+            const auto length = static_cast<unsigned>(std::to_chars(text, text + sizeof(text), values.values[pos]).ptr - text);
+            out.append(digits > length ? digits - length : 0, ' ');
+            out.append(text, length);
+            out += ' ';
+            if ((pos + 1) % values.size == 0) {
+                out += '\n';
+            }
+        }
+    }
+
+private:
+    template <typename GetCell>
+    static void appendCells(std::string &out, unsigned size, Style style, GetCell &&getCell) {
+        // Only the grid pads the cells to the width of the largest value.
+        const auto digits = getDigitCount(size);
+        const auto width = style == Style::Grid ? digits : 0;
+
+        const auto first = out.size();
+        out.resize(first + size * size * (digits + 1) + size);
+        auto p = &out[first];
+        for (auto row = 0U; row < size; row++) {
+            for (auto column = 0U; column < size; column++) {
+                p = appendCell(p, getCell(row, column), style, width);
+                if (style != Style::Mask) {
+                    *p++ = ' ';
+                }
+            }
+            if (style == Style::Grid) {
+                *p++ = '\n';
+            } else {
+                if (style == Style::Compact) {
+                    p--;
+                }
+                *p++ = '/';
+            }
+        }
+        if (style != Style::Grid && size != 0) {
+            p[-1] = '\n';
+        }
+        out.resize(static_cast<size_t>(p - out.data()));
+    }
+
+    static unsigned getDigitCount(unsigned value) {
+        auto digits = 0U;
+        do {
+            value /= 10;
+            digits++;
+        } while (value > 0);
+        return digits;
+    }
+
+    static char *appendCell(char *p, const TableBase::Cell &cell, Style style, unsigned width) {
+        if (style == Style::Mask) {
+            switch (cell.getState()) {
+            case TableBase::Cell::State::Deleted:
+                *p++ = '1';
+                break;
+
+            case TableBase::Cell::State::Final:
+                *p++ = '0';
+                break;
+
+            case TableBase::Cell::State::Unknown:
+                *p++ = '?';
+                break;
+            }
+            return p;
+        }
+
+        char digits[16];
+        auto length = 1U;
+        switch (cell.getState()) {
+        case TableBase::Cell::State::Deleted:
+            digits[0] = '-';
+            break;
+
+        case TableBase::Cell::State::Final:
+            length = static_cast<unsigned>(std::to_chars(digits, digits + sizeof(digits), cell.getValue()).ptr - digits);
+            break;
+
+        case TableBase::Cell::State::Unknown:
+            digits[0] = '?';
+            break;
+        }
+
+        for (; width > length; width--) {
+            *p++ = ' ';
+        }
+        std::memcpy(p, digits, length);
+        return p + length;
+    }
+};
+
+template <unsigned Words, unsigned Size>
+std::ostream& operator<<(std::ostream &out, const Table<Words, Size> &t) {
+    std::string text;
+    TableFormatter::append(text, t, TableFormatter::Style::Grid);
+    return out.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+template <typename T>
+struct TypeTag {
+    using type = T;
+};
+
+// A Table for Size x Size boards with the size fixed at compile time. Its
+// bit boards have just the words the board needs, so the bulk operations
+// don't touch words beyond the board.
+template <unsigned Size>
+using FixedSizeTable = Table<(Size * Size + 63) / 64, Size>;
+
+// Calls function with a TypeTag of the Table instantiation for a size x size
+// board: the one fixed to that size for the common sizes, the smallest that
+// fits it for the rest.
+template <typename Function>
+void visitTableType(unsigned size, Function &&function) {
+    switch (size) {
+    case 5:
+        function(TypeTag<FixedSizeTable<5>>());
+        return;
+    case 8:
+        function(TypeTag<FixedSizeTable<8>>());
+        return;
+    case 10:
+        function(TypeTag<FixedSizeTable<10>>());
+        return;
+    case 12:
+        function(TypeTag<FixedSizeTable<12>>());
+        return;
+    case 15:
+        function(TypeTag<FixedSizeTable<15>>());
+        return;
+    case 16:
+        function(TypeTag<FixedSizeTable<16>>());
+        return;
+    case 20:
+        function(TypeTag<FixedSizeTable<20>>());
+        return;
+    }
+
+    if (size <= Table<1>::Capacity) {
+        function(TypeTag<Table<1>>());
+
+    } else if (size <= Table<4>::Capacity) {
+        function(TypeTag<Table<4>>());
+
+    } else if (size <= Table<16>::Capacity) {
+        function(TypeTag<Table<16>>());
+
+    } else if (size <= Table<64>::Capacity) {
+        function(TypeTag<Table<64>>());
+
+    } else if (size <= Table<256>::Capacity) {
+        function(TypeTag<Table<256>>());
+
+    } else if (size <= Table<1024>::Capacity) {
+        function(TypeTag<Table<1024>>());
+
+    } else {
+        throw TableBase::InvalidShapeException();
+    }
+}
+
+// Reads tables from a stream through a large buffer, parsing the values in
+// place. Tables are separated by blank lines, so one stream can hold many
+// of them.
+class TableReader {
+private:
+    static constexpr size_t ChunkSize = 1 << 20;
+
+    std::istream &in;
+    std::vector<char> buffer;
+    size_t begin, end;
+    bool endOfInput;
+
+public:
+    TableReader(std::istream &in):
+        in(in),
+        buffer(ChunkSize),
+        begin(0),
+        end(0),
+        endOfInput(false) { }
+
+    // Reads the next table into values, returns false at the end of the
+    // input. A malformed table is still consumed up to its end before the
+    // error is thrown, so reading can go on with the next one.
+    bool read(TableValues &values) {
+        values.size = 0;
+        values.values.clear();
+        const char *error = nullptr;
+        auto rowCount = 0U;
+
+        const char *line;
+        const char *lineEnd;
+        while (nextLine(line, lineEnd)) {
+            const auto rowStart = values.values.size();
+            auto p = skipSpaces(line, lineEnd);
+            if (p == lineEnd) {
+                if (rowCount != 0 || error != nullptr) {
+                    break;
+                }
+                continue;
+            }
+
+            while (p != lineEnd) {
+                unsigned value;
+                const auto result = std::from_chars(p, lineEnd, value);
+                if (result.ec != std::errc() || (result.ptr != lineEnd && !isSpace(*result.ptr))) {
+                    if (error == nullptr) {
+                        error = "non numeric value encountered";
+                    }
+                    break;
+                }
+                values.values.push_back(value);
+                p = skipSpaces(result.ptr, lineEnd);
+            }
+
+            const auto rowSize = static_cast<unsigned>(values.values.size() - rowStart);
+            if (rowCount == 0) {
+                values.size = rowSize;
+            } else if (rowSize != values.size && error == nullptr) {
+                error = "invalid table shape";
+            }
+            rowCount++;
+        }
+
+        if (error != nullptr) {
+            throw std::logic_error(error);
+        }
+
+        if (rowCount != values.size) {
+            throw std::logic_error("invalid table shape");
+        }
+
+        return rowCount != 0;
+    }
+
+private:
+    static bool isSpace(char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    static const char *skipSpaces(const char *p, const char *end) {
+        while (p != end && isSpace(*p)) {
+            p++;
+        }
+        return p;
+    }
+
+    // Finds the next line in the buffer, refilling it as needed. A line
+    // longer than the buffer grows it.
+    bool nextLine(const char *&line, const char *&lineEnd) {
+        while (true) {
+            const auto data = buffer.data();
+            const auto newline = static_cast<const char *>(std::memchr(data + begin, '\n', end - begin));
+            if (newline != nullptr) {
+                line = data + begin;
+                lineEnd = newline;
+                begin = newline - data + 1;
+                return true;
+            }
+
+            if (endOfInput) {
+                if (begin == end) {
+                    return false;
+                }
+                line = data + begin;
+                lineEnd = data + end;
+                begin = end;
+                return true;
+            }
+
+            std::memmove(data, data + begin, end - begin);
+            end -= begin;
+            begin = 0;
+            if (end == buffer.size()) {
+                buffer.resize(2 * buffer.size());
+            }
+
+            in.read(buffer.data() + end, buffer.size() - end);
+            end += static_cast<size_t>(in.gcount());
+            endOfInput = !in;
+        }
+    }
+};
+
+// A 64-bit hash of a byte string, mixing 8 bytes at a time.
+inline uint64_t hashBytes(const uint8_t *data, size_t size, uint64_t seed = 0) {
+    const auto mix = [](uint64_t value) {
+        value ^= value >> 31;
+        value *= 0xbf58476d1ce4e5b9ULL;
+        value ^= value >> 29;
+        value *= 0x94d049bb133111ebULL;
+        return value ^ (value >> 32);
+    };
+
+    auto hash = seed ^ (size * 0x9e3779b97f4a7c15ULL);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        hash = (hash ^ mix(word)) * 0x9e3779b97f4a7c15ULL;
+    }
+    uint64_t word = 0;
+    std::memcpy(&word, data + i, size - i);
+    return mix(hash ^ mix(word));
+}
+
+// Binary corpus files hold many tables, optionally with their results, in
+// a compact form. All integers are little endian:
+//
+//   header   "HTRB", uint32 version
+//   records  one per table, see CorpusWriter::write
+//   index    uint64 file offset of every record
+//   trailer  uint64 record count, uint64 index offset, "HTRI"
+//
+// The trailer comes last so a corpus is written in a single pass, and the
+// index lets a reader pick out any record without scanning the others.
+struct CorpusFormat {
+    static constexpr char HeaderMagic[4] = {'H', 'T', 'R', 'B'};
+    static constexpr char TrailerMagic[4] = {'H', 'T', 'R', 'I'};
+    static constexpr uint32_t Version = 1;
+    static constexpr size_t HeaderSize = 8;
+    static constexpr size_t RecordHeaderSize = 4;
+    static constexpr size_t TrailerSize = 20;
+
+    // Flags of a record.
+    static constexpr uint8_t Searched = 1;
+    static constexpr uint8_t Exhaustive = 2;
+    static constexpr uint8_t TimedOut = 4;
+    static constexpr uint8_t HasStats = 8;
+    // The table was to be solved but has no result, see SolveResult::error.
+    static constexpr uint8_t Failed = 16;
+
+    static void putUint(std::vector<uint8_t> &buffer, uint64_t value, unsigned bytes) {
+        for (auto i = 0U; i < bytes; i++) {
+            buffer.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    static uint64_t getUint(const uint8_t *data, unsigned bytes) {
+        auto value = uint64_t(0);
+        for (auto i = bytes; i-- > 0;) {
+            value = (value << 8) | data[i];
+        }
+        return value;
+    }
+
+    // The narrowest width from 4 to 8 bits that holds the values 1..size.
+    static unsigned getValueBits(unsigned size) {
+        auto bits = 4U;
+        while ((1U << bits) <= size) {
+            bits++;
+        }
+        return bits;
+    }
+
+    static size_t getPackedSize(size_t count, unsigned bits) {
+        return (count * bits + 7) / 8;
+    }
+
+    // Packs count values of the given width from the low bits of each byte
+    // up, a value may straddle two bytes.
+    template <typename Value>
+    static void pack(std::vector<uint8_t> &buffer, const Value *values, size_t count, unsigned bits) {
+        const auto first = buffer.size();
+        buffer.resize(first + getPackedSize(count, bits), 0);
+        for (size_t i = 0; i < count; i++) {
+            const auto bit = i * bits;
+            const auto value = static_cast<unsigned>(values[i]) << (bit % 8);
+            buffer[first + bit / 8] |= static_cast<uint8_t>(value);
+            if (bit % 8 + bits > 8) {
+                buffer[first + bit / 8 + 1] |= static_cast<uint8_t>(value >> 8);
+            }
+        }
+    }
+
+    static unsigned unpack(const uint8_t *data, size_t index, unsigned bits) {
+        const auto bit = index * bits;
+        auto value = static_cast<unsigned>(data[bit / 8]) >> (bit % 8);
+        if (bit % 8 + bits > 8) {
+            value |= static_cast<unsigned>(data[bit / 8 + 1]) << (8 - bit % 8);
+        }
+        return value & ((1U << bits) - 1);
+    }
+};
+
+// The amount of work a search did: nodes are the states it visited, branch
+// points the nodes where propagation got stuck and a cell had to be guessed.
+// The rest is only counted with HITORI_ENABLE_STATS.
+struct SearchStats {
+    unsigned long long nodes = 0;
+    unsigned long long branchPoints = 0;
+#ifdef HITORI_ENABLE_STATS
+    using Clock = std::chrono::steady_clock;
+
+    unsigned long long finalizeCalls = 0;
+    unsigned long long deleteCalls = 0;
+    // The nodes found contradictory, by the reason.
+    unsigned long long conflicts[TableBase::ConflictCount] = {};
+    unsigned maxDepth = 0;
+    // The second branches a learned nogood showed to fail as well.
+    unsigned long long backjumps = 0;
+    // The time spent in propagate(), and in the whole search.
+    Clock::duration propagationTime = Clock::duration::zero();
+    Clock::duration searchTime = Clock::duration::zero();
+
+    void addConflict(TableBase::Conflict conflict) {
+        if (conflict != TableBase::Conflict::None) {
+            conflicts[static_cast<unsigned>(conflict)]++;
+        }
+    }
+
+    // Adds the finalize and delete calls t made since it had the counts of
+    // start.
+    template <typename TableType>
+    void addCalls(const TableType &t, unsigned long long finalizeStart, unsigned long long deleteStart) {
+        finalizeCalls += t.getFinalizeCallCount() - finalizeStart;
+        deleteCalls += t.getDeleteCallCount() - deleteStart;
+    }
+#endif
+
+    void merge(const SearchStats &other) {
+        nodes += other.nodes;
+        branchPoints += other.branchPoints;
+#ifdef HITORI_ENABLE_STATS
+        finalizeCalls += other.finalizeCalls;
+        deleteCalls += other.deleteCalls;
+        for (auto i = 0U; i < TableBase::ConflictCount; i++) {
+            conflicts[i] += other.conflicts[i];
+        }
+        maxDepth = std::max(maxDepth, other.maxDepth);
+        backjumps += other.backjumps;
+        propagationTime += other.propagationTime;
+        searchTime += other.searchTime;
+#endif
+    }
+};
+
+// Lets another thread, e.g. the one serving a request, stop a search.
+class CancellationToken {
+private:
+    std::atomic<bool> cancelled;
+
+public:
+    CancellationToken():
+        cancelled(false) { }
+
+    void cancel() {
+        cancelled.store(true, std::memory_order_relaxed);
+    }
+
+    bool isCancelled() const {
+        return cancelled.load(std::memory_order_relaxed);
+    }
+};
+
+// The limits of a search: a wall clock deadline, a node budget and a
+// cancellation token, each optional. Searches charge it for every node and
+// stop once it is exhausted. A charge is a few relaxed atomic operations,
+// the clock is only read every CheckInterval nodes of a search.
+class SearchBudget {
+public:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    static constexpr unsigned long long CheckInterval = 256;
+
+    bool hasDeadline;
+    Clock::time_point deadline;
+    unsigned long long nodeLimit;
+    const CancellationToken *cancellationToken;
+    // Shared by the workers of a parallel search.
+    std::atomic<unsigned long long> nodeCount;
+    std::atomic<bool> exhausted;
+
+public:
+    SearchBudget():
+        hasDeadline(false),
+        nodeLimit(0),
+        cancellationToken(nullptr),
+        nodeCount(0),
+        exhausted(false) { }
+
+    void setDeadline(Clock::time_point time) {
+        hasDeadline = true;
+        deadline = time;
+    }
+
+    // A limit of 0 means no limit.
+    void setNodeLimit(unsigned long long limit) {
+        nodeLimit = limit;
+    }
+
+    void setCancellationToken(const CancellationToken *token) {
+        cancellationToken = token;
+    }
+
+    // Whether a search ran out of the budget.
+    bool isExhausted() const {
+        return exhausted.load(std::memory_order_relaxed);
+    }
+
+    // Charges a node, searchNodes is the number of nodes the calling search
+    // visited so far. Returns whether the search has to stop.
+    bool charge(unsigned long long searchNodes) {
+        if ((nodeLimit != 0 && nodeCount.fetch_add(1, std::memory_order_relaxed) >= nodeLimit) ||
+            (cancellationToken != nullptr && cancellationToken->isCancelled()) ||
+            (hasDeadline && searchNodes % CheckInterval == 0 && Clock::now() >= deadline)) {
+            exhausted.store(true, std::memory_order_relaxed);
+            return true;
+        }
+        return isExhausted();
+    }
+};
+
+// A solved table, or the reason it couldn't be solved.
+struct SolveResult {
+    bool success = false;
+    // The error that kept the table from being searched, if any.
+    std::string error;
+    unsigned long long solutionCount = 0;
+    // Whether the search ran to completion, so solutionCount is exact.
+    bool exhaustive = false;
+    // Whether the search ran out of its SearchBudget.
+    bool timedOut = false;
+    // The deleted cells of the first solution, one bit per cell in row
+    // major order, packed like CorpusFormat::pack with 1 bit values.
+    std::vector<uint8_t> solutionMask;
+    // The printable result, only rendered for text output.
+    std::string text;
+    SearchStats stats;
+};
+
+class CorpusWriter {
+private:
+    std::ostream &out;
+    std::vector<uint64_t> offsets;
+    uint64_t offset;
+    std::vector<uint8_t> buffer;
+    bool writeStats;
+
+public:
+    // With writeStats, the records of searched tables keep the node and
+    // branch point counts of their search.
+    CorpusWriter(std::ostream &out, bool writeStats = false):
+        out(out),
+        offset(0),
+        writeStats(writeStats) {
+
+        buffer.insert(buffer.end(), CorpusFormat::HeaderMagic, CorpusFormat::HeaderMagic + 4);
+        CorpusFormat::putUint(buffer, CorpusFormat::Version, 4);
+        flush();
+    }
+
+    // Appends a record: uint8 size, uint8 bits per value, uint8 flags, a
+    // reserved byte, then the packed values. A searched table goes on with
+    // its uint64 solution count and, if it has any, the solution's mask;
+    // then the uint64 node and branch point counts, if it has the HasStats
+    // flag. A result with an error only sets the Failed flag.
+    void write(const TableValues &values, const SolveResult *result) {
+        if (values.size == 0 || values.size > TableBase::MaxSize || values.values.size() != values.size * values.size) {
+            throw TableBase::InvalidShapeException();
+        }
+        for (const auto value : values.values) {
+            if (value == 0 || value > values.size) {
+                throw TableBase::InvalidValueException();
+            }
+        }
+
+        const auto bits = CorpusFormat::getValueBits(values.size);
+        auto flags = uint8_t(0);
+        if (result != nullptr && !result->error.empty()) {
+            flags |= CorpusFormat::Failed;
+            result = nullptr;
+        } else if (result != nullptr) {
+            flags |= CorpusFormat::Searched;
+            if (result->exhaustive) {
+                flags |= CorpusFormat::Exhaustive;
+            }
+            if (result->timedOut) {
+                flags |= CorpusFormat::TimedOut;
+            }
+            if (writeStats) {
+                flags |= CorpusFormat::HasStats;
+            }
+        }
+
+        offsets.push_back(offset + buffer.size());
+        CorpusFormat::putUint(buffer, values.size, 1);
+        CorpusFormat::putUint(buffer, bits, 1);
+        CorpusFormat::putUint(buffer, flags, 1);
+        CorpusFormat::putUint(buffer, 0, 1);
+        CorpusFormat::pack(buffer, values.values.data(), values.values.size(), bits);
+
+        if (result != nullptr) {
+            CorpusFormat::putUint(buffer, result->solutionCount, 8);
+            if (result->solutionCount != 0) {
+                buffer.insert(buffer.end(), result->solutionMask.begin(), result->solutionMask.end());
+            }
+            if (writeStats) {
+                CorpusFormat::putUint(buffer, result->stats.nodes, 8);
+                CorpusFormat::putUint(buffer, result->stats.branchPoints, 8);
+            }
+        }
+
+        if (buffer.size() >= (1 << 16)) {
+            flush();
+        }
+    }
+
+    // Writes the index and the trailer, the corpus is complete afterwards.
+    void finish() {
+        const auto indexOffset = offset + buffer.size();
+        for (const auto recordOffset : offsets) {
+            CorpusFormat::putUint(buffer, recordOffset, 8);
+        }
+        CorpusFormat::putUint(buffer, offsets.size(), 8);
+        CorpusFormat::putUint(buffer, indexOffset, 8);
+        buffer.insert(buffer.end(), CorpusFormat::TrailerMagic, CorpusFormat::TrailerMagic + 4);
+        flush();
+        out.flush();
+    }
+
+private:
+    void flush() {
+        out.write(reinterpret_cast<const char *>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+        offset += buffer.size();
+        buffer.clear();
+    }
+};
+
+class CorpusReader {
+public:
+    class CorruptCorpusException : public std::runtime_error {
+    public:
+        CorruptCorpusException():
+            std::runtime_error("corrupt corpus file") { }
+    };
+
+private:
+    static constexpr size_t WindowSize = 1 << 20;
+
+    std::istream &in;
+    std::vector<uint64_t> offsets;
+    // A window of the file starting at windowStart, so reading the records
+    // one after the other doesn't seek for each of them.
+    std::vector<uint8_t> window;
+    uint64_t windowStart;
+
+public:
+    // Reads the index of the corpus in the seekable stream in.
+    CorpusReader(std::istream &in):
+        in(in),
+        windowStart(0) {
+
+        in.seekg(0, std::ios::end);
+        const auto fileSize = static_cast<uint64_t>(in.tellg());
+        if (!in || fileSize < CorpusFormat::HeaderSize + CorpusFormat::TrailerSize) {
+            throw CorruptCorpusException();
+        }
+
+        const auto header = readAt(0, CorpusFormat::HeaderSize);
+        if (std::memcmp(header, CorpusFormat::HeaderMagic, 4) != 0 ||
+            CorpusFormat::getUint(header + 4, 4) != CorpusFormat::Version) {
+            throw CorruptCorpusException();
+        }
+
+        const auto trailer = readAt(fileSize - CorpusFormat::TrailerSize, CorpusFormat::TrailerSize);
+        const auto count = CorpusFormat::getUint(trailer, 8);
+        const auto indexOffset = CorpusFormat::getUint(trailer + 8, 8);
+        if (std::memcmp(trailer + 16, CorpusFormat::TrailerMagic, 4) != 0 ||
+            indexOffset < CorpusFormat::HeaderSize ||
+            indexOffset > fileSize - CorpusFormat::TrailerSize ||
+            (fileSize - CorpusFormat::TrailerSize - indexOffset) / 8 != count) {
+            throw CorruptCorpusException();
+        }
+
+        const auto index = readAt(indexOffset, count * 8);
+        offsets.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            offsets[i] = CorpusFormat::getUint(index + 8 * i, 8);
+            if (offsets[i] < CorpusFormat::HeaderSize || offsets[i] >= indexOffset) {
+                throw CorruptCorpusException();
+            }
+        }
+    }
+
+    size_t getRecordCount() const {
+        return offsets.size();
+    }
+
+    // A hash of the whole corpus, reading it through. Tells corpora apart
+    // even if their records have the same sizes.
+    uint64_t getFingerprint() {
+        in.clear();
+        in.seekg(0, std::ios::end);
+        const auto fileSize = static_cast<uint64_t>(in.tellg());
+        auto hash = fileSize;
+        for (uint64_t position = 0; position < fileSize; position += WindowSize) {
+            const auto length = std::min<uint64_t>(WindowSize, fileSize - position);
+            hash = hashBytes(readAt(position, length), static_cast<size_t>(length), hash);
+        }
+        return hash;
+    }
+
+    // Reads the table of record index, and its result into result if it
+    // isn't null. Returns whether the record holds a result; that of a
+    // Failed record only has an error.
+    bool read(size_t index, TableValues &values, SolveResult *result = nullptr) {
+        const auto header = readAt(offsets.at(index), CorpusFormat::RecordHeaderSize);
+        const auto size = header[0];
+        const auto bits = header[1];
+        const auto flags = header[2];
+        if (size == 0 || bits < CorpusFormat::getValueBits(size) || bits > 8) {
+            throw CorruptCorpusException();
+        }
+
+        const auto cellCount = size_t(size) * size;
+        const auto valuesSize = CorpusFormat::getPackedSize(cellCount, bits);
+        const auto maskSize = CorpusFormat::getPackedSize(cellCount, 1);
+        const auto searched = (flags & CorpusFormat::Searched) != 0;
+        const auto bodyOffset = offsets[index] + CorpusFormat::RecordHeaderSize;
+        const auto body = readAt(bodyOffset, valuesSize + (searched ? 8 : 0));
+
+        values.size = size;
+        values.values.resize(cellCount);
+        for (size_t i = 0; i < cellCount; i++) {
+            values.values[i] = CorpusFormat::unpack(body, i, bits);
+        }
+
+        const auto failed = (flags & CorpusFormat::Failed) != 0;
+        if (failed && result != nullptr) {
+            *result = SolveResult();
+            result->error = "the table wasn't solved";
+        }
+        if (!searched || result == nullptr) {
+            return searched || failed;
+        }
+
+        result->error.clear();
+        result->text.clear();
+        result->solutionCount = CorpusFormat::getUint(body + valuesSize, 8);
+        result->exhaustive = (flags & CorpusFormat::Exhaustive) != 0;
+        result->timedOut = (flags & CorpusFormat::TimedOut) != 0;
+        result->success = result->solutionCount != 0 && !result->timedOut;
+        result->solutionMask.clear();
+        if (result->solutionCount != 0) {
+            const auto mask = readAt(bodyOffset + valuesSize + 8, maskSize);
+            result->solutionMask.assign(mask, mask + maskSize);
+        }
+        result->stats = SearchStats();
+        if ((flags & CorpusFormat::HasStats) != 0) {
+            const auto stats = readAt(bodyOffset + valuesSize + 8 + result->solutionMask.size(), 16);
+            result->stats.nodes = CorpusFormat::getUint(stats, 8);
+            result->stats.branchPoints = CorpusFormat::getUint(stats + 8, 8);
+        }
+        return true;
+    }
+
+private:
+    // Returns the length bytes at position, valid until the next call.
+    const uint8_t *readAt(uint64_t position, uint64_t length) {
+        if (position < windowStart || position + length > windowStart + window.size()) {
+            window.resize(static_cast<size_t>(std::max<uint64_t>(length, WindowSize)));
+            windowStart = position;
+            in.clear();
+            in.seekg(static_cast<std::streamoff>(position));
+            in.read(reinterpret_cast<char *>(window.data()), static_cast<std::streamsize>(window.size()));
+            window.resize(static_cast<size_t>(in.gcount()));
+            if (window.size() < length) {
+                throw CorruptCorpusException();
+            }
+        }
+        return window.data() + (position - windowStart);
+    }
+};
+
+// Whether the stream starts with the header of a binary corpus. The stream
+// is rewound afterwards.
+inline bool isCorpus(std::istream &in) {
+    char magic[4] = {};
+    in.read(magic, 4);
+    const auto corpus = in.gcount() == 4 && std::memcmp(magic, CorpusFormat::HeaderMagic, 4) == 0;
+    in.clear();
+    in.seekg(0);
+    return corpus;
+}
+
+// Learns nogoods from the conflicts of a depth-first search, and checks
+// them while it propagates. A nogood is a set of cell states that can't all
+// hold.
+//
+// A failed node's nogood comes from walking back from the cells of the
+// conflict to the decisions they follow from. The table keeps no reasons,
+// so a cell's reason is found again from the order of the trail. It can
+// be:
+// - a deleted neighbor
+// - a final copy of its value
+// - the deleted copies that left it unique
+// - the loop of deleted cells its deletion would close
+// - the nogood that forced it
+//
+// When both branches of a decision fail, their nogoods are resolved into
+// one without the decision. A first branch whose nogood doesn't contain
+// its decision dooms the second branch too, so the search jumps over it.
+//
+// Nogoods hold relative to the state the search started from, and reset
+// forgets them. At most MaxNogoods are kept; when the store is full, the
+// half that fired least is dropped. The learner assumes the search takes
+// every branch itself, so it isn't used by ParallelSolver.
+//
+// The unique cell rule of propagate() is a dominance rule, not a logical
+// consequence: a solution deleting such a cell has a twin that keeps it.
+// The nogoods treat it like the other rules, so they may cut off solutions
+// that aren't minimal, but never a minimal one: a minimal solution deletes
+// no cell without a final copy, and so obeys the rule. Learning leaves the
+// solutions the search reports, see Table::isMinimal, unchanged.
+template <typename TableType>
+class NogoodLearner {
+public:
+    using State = TableBase::Cell::State;
+    using Conflict = TableBase::Conflict;
+    // A cell and a state: pos * 2, plus 1 for Deleted.
+    using Literal = unsigned;
+
+    static constexpr unsigned MaxNogoods = 1 << 12;
+    static constexpr unsigned MaxLength = 32;
+    static constexpr Literal NoLiteral = ~0U;
+
+    static Literal makeLiteral(unsigned pos, State state) {
+        return pos * 2 + (state == State::Deleted ? 1 : 0);
+    }
+
+private:
+    struct Nogood {
+        std::vector<Literal> literals;
+        unsigned long long activity;
+    };
+
+    unsigned size;
+    std::vector<Nogood> nogoods;
+    // The nogoods containing each literal.
+    std::vector<std::vector<unsigned>> occurrences;
+    // The other literals of the last nogood that forced each cell. They are
+    // checked before use in case the cell was set again for another reason.
+    std::vector<std::vector<Literal>> forcedReasons;
+    std::vector<uint8_t> forced;
+    // The state change being applied, with the literals forcing it, or null
+    // for a decision. A conflict may leave that cell unknown.
+    Literal pendingLiteral;
+    const std::vector<Literal> *pendingReason;
+    // The nogood the last LearnedNogood conflict was found in.
+    std::vector<Literal> conflictNogood;
+
+    // The nogood of the subtree the search just left, if that subtree failed.
+    std::vector<Literal> failure;
+    bool failureValid;
+    // The same for the first branch of every decision on the stack.
+    std::vector<std::vector<Literal>> firstBranchFailures;
+    std::vector<uint8_t> firstBranchValid;
+
+    // Scratch of the analysis: the trail index of every set cell, the cells
+    // being explained, and the search for a loop of deleted cells.
+    std::vector<size_t> trailIndices;
+    std::vector<unsigned> visited;
+    unsigned visitStamp;
+    std::vector<unsigned> cells;
+    std::vector<unsigned> loopVisited;
+    unsigned loopStamp;
+    std::vector<unsigned> loopParents;
+    std::vector<unsigned> loopQueue;
+
+public:
+    NogoodLearner():
+        size(0),
+        pendingLiteral(NoLiteral),
+        pendingReason(nullptr),
+        failureValid(false),
+        visitStamp(0),
+        loopStamp(0) { }
+
+    // Forgets every nogood, for a search of a size x size board from a new
+    // state. The storage is kept.
+    void reset(unsigned boardSize) {
+        size = boardSize;
+        const auto cellCount = size * size;
+        nogoods.clear();
+        occurrences.resize(2 * cellCount);
+        for (auto &list : occurrences) {
+            list.clear();
+        }
+        forcedReasons.resize(cellCount);
+        forced.assign(cellCount, 0);
+        pendingLiteral = NoLiteral;
+        pendingReason = nullptr;
+        failureValid = false;
+
+        trailIndices.resize(cellCount);
+        visited.assign(cellCount, 0);
+        visitStamp = 0;
+        loopVisited.assign(cellCount + 1, 0);
+        loopStamp = 0;
+        loopParents.resize(cellCount + 1);
+    }
+
+    size_t getNogoodCount() const {
+        return nogoods.size();
+    }
+
+    // Called before a decision is applied, so that a conflict leaving the
+    // cell unknown can still be explained.
+    void setPendingDecision(Literal literal) {
+        pendingLiteral = literal;
+        pendingReason = nullptr;
+    }
+
+    // Checks the nogoods containing the cells set since the trail index
+    // from. A nogood with every literal set is a conflict. A nogood with one
+    // literal left forces the opposite state on that cell. The table is
+    // propagated after forcing.
+    Conflict propagate(TableType &t, size_t from) {
+        if (nogoods.empty()) {
+            return Conflict::None;
+        }
+
+        auto index = from;
+        while (true) {
+            auto forcedAny = false;
+            for (; index < t.getTrailSize(); index++) {
+                const auto pos = t.getTrailPos(index);
+                for (const auto id : occurrences[makeLiteral(pos, t.getState(pos))]) {
+                    auto &nogood = nogoods[id];
+                    auto open = NoLiteral;
+                    auto openCount = 0U;
+                    auto satisfied = false;
+                    for (const auto literal : nogood.literals) {
+                        const auto state = t.getState(literal / 2);
+                        if (state == State::Unknown) {
+                            open = literal;
+                            if (++openCount > 1) {
+                                break;
+                            }
+                        } else if (makeLiteral(literal / 2, state) != literal) {
+                            satisfied = true;
+                            break;
+                        }
+                    }
+                    if (satisfied || openCount > 1) {
+                        continue;
+                    }
+
+                    nogood.activity++;
+                    if (openCount == 0) {
+                        conflictNogood = nogood.literals;
+                        return Conflict::LearnedNogood;
+                    }
+
+                    const auto openPos = open / 2;
+                    auto &reason = forcedReasons[openPos];
+                    reason.clear();
+                    for (const auto literal : nogood.literals) {
+                        if (literal != open) {
+                            reason.push_back(literal);
+                        }
+                    }
+                    forced[openPos] = 1;
+                    pendingLiteral = open ^ 1;
+                    pendingReason = &reason;
+                    const auto conflict = (open & 1) != 0
+                        ? t.finalizeCell(openPos / size, openPos % size)
+                        : t.deleteCell(openPos / size, openPos % size);
+                    if (conflict != Conflict::None) {
+                        return conflict;
+                    }
+                    pendingLiteral = NoLiteral;
+                    forcedAny = true;
+                }
+            }
+
+            if (!forcedAny) {
+                return Conflict::None;
+            }
+            const auto conflict = t.propagate();
+            if (conflict != Conflict::None) {
+                return conflict;
+            }
+        }
+    }
+
+    // Explains the conflict t just ran into: the failed node's nogood, made
+    // of decisions, which is learned. Cells before the trail index rootSize
+    // hold in the start state. isDecision(index) tells whether the cell at a
+    // trail index was set by a decision.
+    template <typename IsDecision>
+    void fail(const TableType &t, Conflict conflict, size_t rootSize, IsDecision &&isDecision) {
+        failureValid = analyze(t, conflict, rootSize, isDecision);
+        pendingLiteral = NoLiteral;
+        if (failureValid) {
+            learn(failure);
+        }
+    }
+
+    // A solution was found, so its subtree didn't fail.
+    void succeed() {
+        failureValid = false;
+    }
+
+    // The first branch of the decision at depth failed. Returns true if its
+    // nogood doesn't contain the decision, so the second branch fails as
+    // well and the node fails with the same nogood. Otherwise keeps the
+    // nogood for resolve().
+    bool skipsSecondBranch(size_t depth, Literal decision) {
+        if (firstBranchFailures.size() <= depth) {
+            firstBranchFailures.resize(depth + 1);
+            firstBranchValid.resize(depth + 1);
+        }
+        firstBranchValid[depth] = failureValid ? 1 : 0;
+        if (!failureValid) {
+            return false;
+        }
+        if (std::find(failure.begin(), failure.end(), decision) == failure.end()) {
+            return true;
+        }
+        firstBranchFailures[depth] = failure;
+        return false;
+    }
+
+    // Both branches of the decision at depth failed: the node fails with
+    // both nogoods but the branches, which is learned.
+    void resolve(size_t depth, Literal first, Literal second) {
+        if (!failureValid || !firstBranchValid[depth]) {
+            failureValid = false;
+            return;
+        }
+        const auto secondPos = std::find(failure.begin(), failure.end(), second);
+        if (secondPos == failure.end()) {
+            return;
+        }
+
+        failure.erase(secondPos);
+        for (const auto literal : firstBranchFailures[depth]) {
+            if (literal != first) {
+                failure.push_back(literal);
+            }
+        }
+        std::sort(failure.begin(), failure.end());
+        failure.erase(std::unique(failure.begin(), failure.end()), failure.end());
+        learn(failure);
+    }
+
+private:
+    void learn(const std::vector<Literal> &literals) {
+        if (literals.empty() || literals.size() > MaxLength) {
+            return;
+        }
+        if (nogoods.size() >= MaxNogoods) {
+            cleanUp();
+        }
+        const auto id = static_cast<unsigned>(nogoods.size());
+        nogoods.push_back({ literals, 0 });
+        for (const auto literal : literals) {
+            occurrences[literal].push_back(id);
+        }
+    }
+
+    // Keeps the half of the nogoods that fired most, newer first on ties,
+    // and halves their activity so that old merits fade.
+    void cleanUp() {
+        std::vector<unsigned> order(nogoods.size());
+        for (auto i = 0U; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [this](unsigned a, unsigned b) {
+            return nogoods[a].activity != nogoods[b].activity ? nogoods[a].activity > nogoods[b].activity : a > b;
+        });
+        order.resize(order.size() / 2);
+        std::sort(order.begin(), order.end());
+
+        std::vector<Nogood> kept;
+        kept.reserve(MaxNogoods);
+        for (const auto id : order) {
+            kept.push_back(std::move(nogoods[id]));
+            kept.back().activity /= 2;
+        }
+        nogoods.swap(kept);
+
+        for (auto &list : occurrences) {
+            list.clear();
+        }
+        for (auto id = 0U; id < nogoods.size(); id++) {
+            for (const auto literal : nogoods[id].literals) {
+                occurrences[literal].push_back(id);
+            }
+        }
+    }
+
+    void addCell(unsigned pos) {
+        if (visited[pos] != visitStamp) {
+            visited[pos] = visitStamp;
+            cells.push_back(pos);
+        }
+    }
+
+    template <typename IsDecision>
+    bool analyze(const TableType &t, Conflict conflict, size_t rootSize, IsDecision &isDecision) {
+        failure.clear();
+        cells.clear();
+        if (++visitStamp == 0) {
+            std::fill(visited.begin(), visited.end(), 0);
+            visitStamp = 1;
+        }
+        const auto trailSize = t.getTrailSize();
+        for (size_t i = 0; i < trailSize; i++) {
+            trailIndices[t.getTrailPos(i)] = i;
+        }
+
+        const auto pos = t.getConflictPos();
+        switch (conflict) {
+        case Conflict::MultipleFinalizedInRow:
+        case Conflict::MultipleFinalizedInColumn:
+            addCell(pos);
+            addCell(t.getConflictOtherPos());
+            break;
+
+        case Conflict::DeletedNeighbor:
+            addCell(t.getConflictOtherPos());
+            if (!explainPendingDeletion(t, pos, trailSize)) {
+                return false;
+            }
+            break;
+
+        case Conflict::CircularNeighbors:
+            if (!explainPendingDeletion(t, pos, trailSize) || !addLoop(t, pos, trailSize)) {
+                return false;
+            }
+            break;
+
+        case Conflict::LearnedNogood:
+            for (const auto literal : conflictNogood) {
+                addCell(literal / 2);
+            }
+            break;
+
+        default:
+            return false;
+        }
+
+        // The cells added while explaining are explained in turn.
+        for (size_t i = 0; i < cells.size(); i++) {
+            const auto cell = cells[i];
+            const auto state = t.getState(cell);
+            const auto index = trailIndices[cell];
+            if (state == State::Unknown || index >= trailSize) {
+                return false;
+            }
+            if (index < rootSize) {
+                continue;
+            }
+            if (isDecision(index)) {
+                failure.push_back(makeLiteral(cell, state));
+            } else if (!explain(t, cell, state, index)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // The deletion of the cell that ran into the conflict, still unknown.
+    bool explainPendingDeletion(const TableType &t, unsigned pos, size_t trailSize) {
+        if (pendingLiteral == makeLiteral(pos, State::Deleted)) {
+            if (pendingReason == nullptr) {
+                failure.push_back(pendingLiteral);
+            } else {
+                for (const auto literal : *pendingReason) {
+                    addCell(literal / 2);
+                }
+            }
+            return true;
+        }
+        return explain(t, pos, State::Deleted, trailSize);
+    }
+
+    // Adds the cells that made the cell take its state at the trail index,
+    // all of them set before it.
+    bool explain(const TableType &t, unsigned pos, State state, size_t index) {
+        const auto row = pos / size;
+        const auto column = pos % size;
+        const auto value = t.getCell(row, column).getValue();
+        const auto isSetBefore = [&](unsigned other, State otherState) {
+            return t.getState(other) == otherState && trailIndices[other] < index;
+        };
+
+        if (state == State::Deleted) {
+            for (auto i = 0U; i < size; i++) {
+                const auto rowPeer = row * size + i;
+                if (i != column && t.getCell(row, i).getValue() == value && isSetBefore(rowPeer, State::Final)) {
+                    addCell(rowPeer);
+                    return true;
+                }
+                const auto columnPeer = i * size + column;
+                if (i != row && t.getCell(i, column).getValue() == value && isSetBefore(columnPeer, State::Final)) {
+                    addCell(columnPeer);
+                    return true;
+                }
+            }
+            return explainForced(t, pos, index);
+        }
+
+        const unsigned neighbors[4] = {
+            row > 0 ? pos - size : pos,
+            row + 1 < size ? pos + size : pos,
+            column > 0 ? pos - 1 : pos,
+            column + 1 < size ? pos + 1 : pos
+        };
+        for (const auto neighbor : neighbors) {
+            if (neighbor != pos && isSetBefore(neighbor, State::Deleted)) {
+                addCell(neighbor);
+                return true;
+            }
+        }
+        if (explainForced(t, pos, index)) {
+            return true;
+        }
+
+        // Unique: every other copy in its lines was deleted before.
+        auto unique = true;
+        for (auto i = 0U; i < size && unique; i++) {
+            unique = (i == column || t.getCell(row, i).getValue() != value || isSetBefore(row * size + i, State::Deleted)) &&
+                (i == row || t.getCell(i, column).getValue() != value || isSetBefore(i * size + column, State::Deleted));
+        }
+        if (unique) {
+            for (auto i = 0U; i < size; i++) {
+                if (i != column && t.getCell(row, i).getValue() == value) {
+                    addCell(row * size + i);
+                }
+                if (i != row && t.getCell(i, column).getValue() == value) {
+                    addCell(i * size + column);
+                }
+            }
+            return true;
+        }
+        return addLoop(t, pos, index);
+    }
+
+    bool explainForced(const TableType &t, unsigned pos, size_t index) {
+        if (forced[pos] == 0) {
+            return false;
+        }
+        for (const auto literal : forcedReasons[pos]) {
+            const auto other = literal / 2;
+            if (t.getState(other) == State::Unknown || makeLiteral(other, t.getState(other)) != literal ||
+                trailIndices[other] >= index) {
+                return false;
+            }
+        }
+        for (const auto literal : forcedReasons[pos]) {
+            addCell(literal / 2);
+        }
+        return true;
+    }
+
+    // Adds a chain of cells deleted before the trail index that joins two of
+    // the trees the deletion of pos would link, as Table's deletedTrees,
+    // with the node cellCount standing for the border. That chain and pos
+    // close a loop.
+    bool addLoop(const TableType &t, unsigned pos, size_t index) {
+        const auto cellCount = size * size;
+        const auto border = cellCount;
+        const auto isOnBorder = [&](unsigned cell) {
+            const auto r = cell / size;
+            const auto c = cell % size;
+            return r == 0 || c == 0 || r == size - 1 || c == size - 1;
+        };
+        const auto isDeletedBefore = [&](unsigned cell) {
+            return t.getState(cell) == State::Deleted && trailIndices[cell] < index;
+        };
+        // Calls onNode with the diagonal neighbors of a cell deleted before
+        // the index, and the border for the cells on it.
+        const auto forEachNeighbor = [&](unsigned node, auto &&onNode) {
+            if (node == border) {
+                for (auto cell = 0U; cell < cellCount; cell++) {
+                    if (isOnBorder(cell) && isDeletedBefore(cell)) {
+                        onNode(cell);
+                    }
+                }
+                return;
+            }
+            if (isOnBorder(node)) {
+                onNode(border);
+            }
+            const auto r = node / size;
+            const auto c = node % size;
+            const int offsets[4][2] = { { -1, -1 }, { -1, 1 }, { 1, 1 }, { 1, -1 } };
+            for (const auto &offset : offsets) {
+                const auto nr = r + offset[0];
+                const auto nc = c + offset[1];
+                if (nr < size && nc < size && isDeletedBefore(nr * size + nc)) {
+                    onNode(nr * size + nc);
+                }
+            }
+        };
+
+        unsigned sources[5];
+        auto sourceCount = 0U;
+        forEachNeighbor(pos, [&](unsigned node) {
+            sources[sourceCount++] = node;
+        });
+
+        for (auto s = 0U; s + 1 < sourceCount; s++) {
+            if (++loopStamp == 0) {
+                std::fill(loopVisited.begin(), loopVisited.end(), 0);
+                loopStamp = 1;
+            }
+            loopQueue.clear();
+            loopQueue.push_back(sources[s]);
+            loopVisited[sources[s]] = loopStamp;
+            for (size_t i = 0; i < loopQueue.size(); i++) {
+                const auto node = loopQueue[i];
+                if (std::find(sources + s + 1, sources + sourceCount, node) != sources + sourceCount) {
+                    for (auto step = node; ; step = loopParents[step]) {
+                        if (step != border) {
+                            addCell(step);
+                        }
+                        if (step == sources[s]) {
+                            return true;
+                        }
+                    }
+                }
+                forEachNeighbor(node, [&](unsigned next) {
+                    if (loopVisited[next] != loopStamp) {
+                        loopVisited[next] = loopStamp;
+                        loopParents[next] = node;
+                        loopQueue.push_back(next);
+                    }
+                });
+            }
+        }
+        return false;
+    }
+};
+
+// A depth-first search over the branching decisions, driven by a loop over
+// a stack of frames instead of recursion. The stack is allocated up front
+// for the deepest possible search, one frame per cell. The hooks of run()
+// let callers stop the search between nodes and take over branches.
+template <typename TableType>
+class DepthFirstSearch {
+public:
+    struct Decision {
+        unsigned row;
+        unsigned column;
+        bool deleted;
+    };
+
+private:
+    // A branch point: the state before the decision and the decision the
+    // search is in. The deletion is tried first, then the finalization,
+    // unless a hook took that over.
+    struct Frame {
+        TableBase::Checkpoint checkpoint;
+        Decision decision;
+        bool lastBranch;
+    };
+
+public:
+    using FrameStack = std::vector<Frame>;
+
+private:
+    using Learner = NogoodLearner<TableType>;
+
+    TableType &t;
+    SearchStats &stats;
+    FrameStack &frames;
+    // Decisions made before the search started, counted in the depth stats.
+    unsigned depthOffset;
+    bool stoppedOnSolution;
+    NogoodLearner<TableType> *learner;
+
+public:
+    // The frames are kept in storage of the caller, so it can be reused by
+    // the next search.
+    DepthFirstSearch(TableType &t, SearchStats &stats, FrameStack &frames):
+        t(t),
+        stats(stats),
+        frames(frames),
+        depthOffset(0),
+        stoppedOnSolution(false),
+        learner(nullptr) {
+
+        frames.reserve(t.getSize() * t.getSize());
+    }
+
+    // The number of decisions that led from the start of the search to the
+    // current state.
+    unsigned getDepth() const {
+        return static_cast<unsigned>(frames.size());
+    }
+
+    void setDepthOffset(unsigned offset) {
+        depthOffset = offset;
+    }
+
+    // Learns nogoods with the learner, if it isn't null, and prunes and
+    // jumps back with them. Only for searches that hand off no branches.
+    void setLearner(NogoodLearner<TableType> *newLearner) {
+        learner = newLearner;
+    }
+
+    // Rolls t back to the state after the propagation of the first node,
+    // undoing every decision of the search.
+    void rollbackToRoot() {
+        if (!frames.empty()) {
+            t.rollback(frames.front().checkpoint);
+            frames.clear();
+        }
+    }
+
+    // Appends the decisions that led to the current state to path.
+    void appendPath(std::vector<Decision> &path) const {
+        for (const auto &frame : frames) {
+            path.push_back(frame.decision);
+        }
+    }
+
+    // Searches from the state of t and calls onSolution with every minimal
+    // solution found, see Table::isMinimal. onNode is called before every
+    // node is searched and onAlternative with the second branch of every
+    // branch point; a true result means the search is to stop, and the
+    // branch was handed off, respectively. Stopping on a solution leaves t
+    // in the state of that solution. Returns whether the search was stopped.
+    template <typename OnSolution, typename OnNode, typename OnAlternative>
+    bool run(OnSolution &&onSolution, OnNode &&onNode, OnAlternative &&onAlternative) {
+        frames.clear();
+        stoppedOnSolution = false;
+        if (learner != nullptr) {
+            learner->reset(t.getSize());
+        }
+        while (true) {
+            if (onNode(*this)) {
+                return true;
+            }
+            if (enterNode(onSolution, onAlternative)) {
+                continue;
+            }
+            if (stoppedOnSolution) {
+                return true;
+            }
+            if (!backtrack()) {
+                return false;
+            }
+        }
+    }
+
+private:
+    // Propagates the current node and makes its first decision. Returns
+    // whether the search goes on below it, otherwise the node failed or
+    // was a solution.
+    template <typename OnSolution, typename OnAlternative>
+    bool enterNode(OnSolution &onSolution, OnAlternative &onAlternative) {
+        stats.nodes++;
+        HITORI_STATS(stats.maxDepth = std::max(stats.maxDepth, depthOffset + getDepth() + 1));
+        HITORI_STATS(const auto propagationStart = SearchStats::Clock::now());
+        auto conflict = t.propagate();
+        if (conflict == TableBase::Conflict::None && learner != nullptr) {
+            conflict = learner->propagate(t, frames.empty() ? 0 : frames.back().checkpoint.trailSize);
+        }
+        HITORI_STATS(stats.propagationTime += SearchStats::Clock::now() - propagationStart);
+        if (conflict != TableBase::Conflict::None) {
+            HITORI_STATS(stats.addConflict(conflict));
+            fail(conflict);
+            return false;
+        }
+        if (t.isSolved()) {
+            // Only the minimal solutions count, see Table::isMinimal. The
+            // others aren't conflicts, the learner takes them as successes.
+            if (learner != nullptr) {
+                learner->succeed();
+            }
+            stoppedOnSolution = t.isMinimal() && onSolution(t);
+            return false;
+        }
+
+        // The most conflicted cell is the one most likely to be deleted in
+        // the solution, so that branch goes first.
+        stats.branchPoints++;
+        const auto pos = t.getFinalizeCandidatePos();
+        const Decision alternative = { pos.first, pos.second, false };
+        const auto lastBranch = onAlternative(*this, alternative);
+        frames.push_back({ t.getCheckpoint(), { pos.first, pos.second, true }, lastBranch });
+        return apply(frames.back().decision);
+    }
+
+    // Rolls back to the deepest branch point with an untried branch and
+    // takes that branch. Returns false when every branch has been tried.
+    bool backtrack() {
+        while (!frames.empty()) {
+            auto &frame = frames.back();
+            t.rollback(frame.checkpoint);
+            const auto depth = frames.size() - 1;
+            const auto pos = frame.decision.row * t.getSize() + frame.decision.column;
+            if (frame.lastBranch) {
+                if (learner != nullptr) {
+                    learner->resolve(depth, Learner::makeLiteral(pos, TableBase::Cell::State::Deleted),
+                                     Learner::makeLiteral(pos, TableBase::Cell::State::Final));
+                }
+                frames.pop_back();
+                continue;
+            }
+            if (learner != nullptr &&
+                learner->skipsSecondBranch(depth, Learner::makeLiteral(pos, TableBase::Cell::State::Deleted))) {
+                HITORI_STATS(stats.backjumps++);
+                frames.pop_back();
+                continue;
+            }
+
+            frame.decision.deleted = false;
+            frame.lastBranch = true;
+            if (apply(frame.decision)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool apply(const Decision &decision) {
+        if (learner != nullptr) {
+            learner->setPendingDecision(Learner::makeLiteral(decision.row * t.getSize() + decision.column,
+                decision.deleted ? TableBase::Cell::State::Deleted : TableBase::Cell::State::Final));
+        }
+        const auto conflict = decision.deleted
+            ? t.deleteCell(decision.row, decision.column)
+            : t.finalizeCell(decision.row, decision.column);
+        HITORI_STATS(stats.addConflict(conflict));
+        if (conflict != TableBase::Conflict::None) {
+            fail(conflict);
+        }
+        return conflict == TableBase::Conflict::None;
+    }
+
+    // Lets the learner explain the conflict; the decisions are the cells at
+    // the trail sizes of the checkpoints.
+    void fail(TableBase::Conflict conflict) {
+        if (learner == nullptr) {
+            return;
+        }
+        const auto rootSize = frames.empty() ? t.getTrailSize() : frames.front().checkpoint.trailSize;
+        learner->fail(t, conflict, rootSize, [this](size_t index) {
+            const auto frame = std::lower_bound(frames.begin(), frames.end(), index, [](const Frame &f, size_t i) {
+                return f.checkpoint.trailSize < i;
+            });
+            return frame != frames.end() && frame->checkpoint.trailSize == index;
+        });
+    }
+};
+
+// The storage a thread keeps between searches, so that solving a batch of
+// tables only allocates when a board is bigger than the ones before it. A
+// thread runs one search at a time, making a single set enough.
+template <typename TableType>
+struct ThreadWorkspace {
+    // The table solveTable() solves.
+    TableType table;
+    // The first solution countSolutions() found.
+    TableType solution;
+    typename DepthFirstSearch<TableType>::FrameStack frames;
+    NogoodLearner<TableType> learner;
+
+    static ThreadWorkspace &get() {
+        thread_local ThreadWorkspace workspace;
+        return workspace;
+    }
+};
+
+// Searches from the state of t and calls onSolution with every minimal
+// solution found, see Table::isMinimal. The search stops when onSolution
+// returns true, leaving t in the state of that solution, or when the
+// budget, if any, is exhausted, leaving t in the state the first node
+// propagated to. Returns whether it was stopped. Nogoods are learned with
+// the learner if it isn't null.
+template <unsigned Words, unsigned Size, typename OnSolution>
+bool search(Table<Words, Size> &t, OnSolution &&onSolution, SearchStats &stats, SearchBudget *budget = nullptr,
+            NogoodLearner<Table<Words, Size>> *learner = nullptr) {
+    using Search = DepthFirstSearch<Table<Words, Size>>;
+    Search depthFirstSearch(t, stats, ThreadWorkspace<Table<Words, Size>>::get().frames);
+    depthFirstSearch.setLearner(learner);
+    const auto stopped = depthFirstSearch.run(onSolution, [&](const Search &) {
+        return budget != nullptr && budget->charge(stats.nodes);
+    }, [](const Search &, const typename Search::Decision &) {
+        return false;
+    });
+
+    if (stopped && budget != nullptr && budget->isExhausted()) {
+        depthFirstSearch.rollbackToRoot();
+    }
+    return stopped;
+}
+
+// Returns false if the table has no solution, the state of t is undefined
+// in that case.
+template <unsigned Words, unsigned Size>
+bool solve(Table<Words, Size> &t) {
+    SearchStats stats;
+    return t.applyPatterns() == TableBase::Conflict::None && search(t, [](const Table<Words, Size> &) {
+        return true;
+    }, stats);
+}
+
+// Counts the minimal solutions of the table, see Table::isMinimal,
+// stopping at limit; a limit of 2 is enough to tell whether the solution
+// is unique. t holds the first solution found, if there is any. The work
+// done is added to stats if it isn't null. When the budget runs out, the
+// count is the solutions found until then, and t holds the deductions of
+// the root if none was found. Nogoods are learned with learnNogoods.
+template <unsigned Words, unsigned Size>
+unsigned long long countSolutions(Table<Words, Size> &t, unsigned long long limit, SearchStats *stats = nullptr,
+                                  SearchBudget *budget = nullptr, bool learnNogoods = false) {
+    if (t.applyPatterns() != TableBase::Conflict::None) {
+        return 0;
+    }
+
+    auto count = 0ULL;
+    auto &workspace = ThreadWorkspace<Table<Words, Size>>::get();
+    auto &firstSolution = workspace.solution;
+    SearchStats localStats;
+    auto &searchStats = stats != nullptr ? *stats : localStats;
+    HITORI_STATS(const auto searchStart = SearchStats::Clock::now());
+    HITORI_STATS(const auto finalizeStart = t.getFinalizeCallCount());
+    HITORI_STATS(const auto deleteStart = t.getDeleteCallCount());
+    search(t, [&](const Table<Words, Size> &solution) {
+        if (count == 0) {
+            firstSolution = solution;
+        }
+        return ++count >= limit;
+    }, searchStats, budget, learnNogoods ? &workspace.learner : nullptr);
+    HITORI_STATS(searchStats.addCalls(t, finalizeStart, deleteStart));
+    HITORI_STATS(searchStats.searchTime += SearchStats::Clock::now() - searchStart);
+
+    if (count != 0) {
+        t = firstSolution;
+    }
+    return count;
+}
+
+// Searches the branches of the top of the search tree on several threads.
+// Every worker owns a copy of the table and a deque of tasks, a task is the
+// list of branching decisions that leads from the root to a subtree. A
+// worker with an empty deque hands off the second branch of every branching
+// it makes, others steal the oldest, i.e. largest, subtrees from the front
+// of its deque. Reaching the solution limit stops every worker.
+template <typename TableType>
+class ParallelSolver {
+private:
+    using Decision = typename DepthFirstSearch<TableType>::Decision;
+    using Task = std::vector<Decision>;
+
+    class TaskDeque {
+    private:
+        std::mutex mutex;
+        std::deque<Task> tasks;
+
+    public:
+        void push(Task task) {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+
+        bool pop(Task &task) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (tasks.empty()) {
+                return false;
+            }
+            task = std::move(tasks.back());
+            tasks.pop_back();
+            return true;
+        }
+
+        bool steal(Task &task) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (tasks.empty()) {
+                return false;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+            return true;
+        }
+
+        bool isEmpty() {
+            std::lock_guard<std::mutex> lock(mutex);
+            return tasks.empty();
+        }
+
+        void clear() {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.clear();
+        }
+    };
+
+    const unsigned threadCount;
+    std::vector<std::unique_ptr<TaskDeque>> deques;
+    // Tasks pushed but not finished yet, the search is over when it drops
+    // to zero.
+    std::atomic<unsigned> pendingTaskCount;
+    std::atomic<bool> stopped;
+    // Workers without a task sleep on taskAvailable until a task is pushed
+    // or the search is over. Pushing only takes idleMutex while some of
+    // them are idle.
+    std::atomic<unsigned> queuedTaskCount;
+    std::atomic<unsigned> idleWorkerCount;
+    std::mutex idleMutex;
+    std::condition_variable taskAvailable;
+    std::mutex solutionMutex;
+    unsigned long long solutionLimit;
+    unsigned long long solutionCount;
+    std::unique_ptr<TableType> firstSolution;
+    std::vector<SearchStats> workerStats;
+    SearchBudget *budget;
+
+public:
+    ParallelSolver(unsigned threadCount):
+        threadCount(threadCount),
+        pendingTaskCount(0),
+        stopped(false),
+        queuedTaskCount(0),
+        idleWorkerCount(0),
+        solutionLimit(1),
+        solutionCount(0),
+        workerStats(threadCount),
+        budget(nullptr) {
+
+        for (auto i = 0U; i < threadCount; i++) {
+            deques.emplace_back(new TaskDeque());
+        }
+    }
+
+    // Same contract as solve(), on success t holds the solution.
+    bool solve(TableType &t) {
+        return countSolutions(t, 1) != 0;
+    }
+
+    // Same contract as the sequential countSolutions(), the budget is shared
+    // by the workers. A solver can search any number of tables, one at a
+    // time: what the last search left behind is dropped first.
+    unsigned long long countSolutions(TableType &t, unsigned long long limit, SearchStats *stats = nullptr,
+                                      SearchBudget *searchBudget = nullptr) {
+        if (t.applyPatterns() != TableBase::Conflict::None) {
+            return 0;
+        }
+        HITORI_STATS(const auto searchStart = SearchStats::Clock::now());
+
+        // A stopped search leaves the tasks nobody got to in the deques.
+        for (auto &deque : deques) {
+            deque->clear();
+        }
+        std::fill(workerStats.begin(), workerStats.end(), SearchStats());
+        firstSolution.reset();
+        solutionCount = 0;
+        stopped = false;
+        solutionLimit = limit;
+        budget = searchBudget;
+        pendingTaskCount = 1;
+        queuedTaskCount = 1;
+        deques[0]->push(Task());
+
+        std::vector<std::thread> workers;
+        for (auto i = 1U; i < threadCount; i++) {
+            workers.emplace_back([this, &t, i]() {
+                work(i, t);
+            });
+        }
+        work(0, t);
+        for (auto &worker : workers) {
+            worker.join();
+        }
+
+        if (stats != nullptr) {
+            for (const auto &worker : workerStats) {
+                stats->merge(worker);
+            }
+            HITORI_STATS(stats->searchTime += SearchStats::Clock::now() - searchStart);
+        }
+
+        if (firstSolution) {
+            t = *firstSolution;
+        } else if (budget != nullptr && budget->isExhausted()) {
+            t.propagate();
+        }
+        return solutionCount;
+    }
+
+private:
+    void work(unsigned index, const TableType &root) {
+        TableType t(root);
+        const auto rootCheckpoint = t.getCheckpoint();
+        auto &ownDeque = *deques[index];
+        auto &stats = workerStats[index];
+        typename DepthFirstSearch<TableType>::FrameStack frames;
+        DepthFirstSearch<TableType> depthFirstSearch(t, stats, frames);
+
+        Task task;
+        while (!stopped.load(std::memory_order_relaxed) && pendingTaskCount.load() != 0) {
+            if (!ownDeque.pop(task) && !stealTask(index, task)) {
+                waitForTask();
+                continue;
+            }
+            queuedTaskCount--;
+
+            t.rollback(rootCheckpoint);
+            if (replay(t, task)) {
+                search(depthFirstSearch, task, ownDeque, stats);
+            }
+            pendingTaskCount--;
+        }
+
+        HITORI_STATS(stats.addCalls(t, root.getFinalizeCallCount(), root.getDeleteCallCount()));
+
+        // The search is over, for the idle workers as well.
+        {
+            std::lock_guard<std::mutex> lock(idleMutex);
+        }
+        taskAvailable.notify_all();
+    }
+
+    void waitForTask() {
+        std::unique_lock<std::mutex> lock(idleMutex);
+        idleWorkerCount++;
+        taskAvailable.wait(lock, [this]() {
+            return queuedTaskCount.load() != 0 || pendingTaskCount.load() == 0 || stopped.load();
+        });
+        idleWorkerCount--;
+    }
+
+    void pushTask(TaskDeque &deque, Task task) {
+        pendingTaskCount++;
+        deque.push(std::move(task));
+        queuedTaskCount++;
+        if (idleWorkerCount.load() != 0) {
+            {
+                std::lock_guard<std::mutex> lock(idleMutex);
+            }
+            taskAvailable.notify_one();
+        }
+    }
+
+    bool stealTask(unsigned thief, Task &task) {
+        for (auto i = 1U; i < threadCount; i++) {
+            if (deques[(thief + i) % threadCount]->steal(task)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Brings t to the state the branching that created the task left it.
+    static bool replay(TableType &t, const Task &task) {
+        for (const auto &decision : task) {
+            if (t.propagate() != TableBase::Conflict::None || !apply(t, decision)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool apply(TableType &t, const Decision &decision) {
+        const auto conflict = decision.deleted
+            ? t.deleteCell(decision.row, decision.column)
+            : t.finalizeCell(decision.row, decision.column);
+        return conflict == TableBase::Conflict::None;
+    }
+
+    // Searches the subtree of the task. While the worker's own deque is
+    // empty, the second branch of every branch point is handed off to it
+    // instead of being searched here.
+    void search(DepthFirstSearch<TableType> &depthFirstSearch, const Task &task, TaskDeque &ownDeque, const SearchStats &stats) {
+        depthFirstSearch.setDepthOffset(static_cast<unsigned>(task.size()));
+        depthFirstSearch.run([&](const TableType &t) {
+            std::lock_guard<std::mutex> lock(solutionMutex);
+            // Another worker may have reached the limit since this one last
+            // looked at stopped.
+            if (solutionCount >= solutionLimit) {
+                return true;
+            }
+            if (!firstSolution) {
+                firstSolution.reset(new TableType(t));
+            }
+            if (++solutionCount >= solutionLimit) {
+                stopped = true;
+            }
+            return stopped.load();
+
+        }, [&](const DepthFirstSearch<TableType> &) {
+            if (budget != nullptr && budget->charge(stats.nodes)) {
+                stopped = true;
+            }
+            return stopped.load(std::memory_order_relaxed);
+
+        }, [&](const DepthFirstSearch<TableType> &current, const Decision &alternative) {
+            if (!ownDeque.isEmpty()) {
+                return false;
+            }
+
+            Task handedOff(task);
+            current.appendPath(handedOff);
+            handedOff.push_back(alternative);
+            pushTask(ownDeque, std::move(handedOff));
+            return true;
+        });
+    }
+};
+
+// Edits a board one cell at a time for an interactive client. Every edit
+// runs the propagation of that cell only, on top of the state left by the
+// earlier ones: a click costs microseconds, unlike solving the board anew.
+// The edits are kept in a list, so an edit can be taken back without
+// undoing the ones made after it, which are replayed instead.
+template <typename TableType>
+class BoardEditor {
+public:
+    using State = TableBase::Cell::State;
+    using Conflict = TableBase::Conflict;
+
+    enum class Status {
+        // The edit contradicts the board, it wasn't applied.
+        Contradiction,
+        // Propagation found no contradiction, which doesn't prove that
+        // there is a solution; isSolvable() searches for one.
+        Consistent,
+        Solved
+    };
+
+    // A cell whose state an edit changed, the edited cell included.
+    struct Change {
+        unsigned row;
+        unsigned column;
+        State state;
+    };
+
+private:
+    struct Edit {
+        unsigned row;
+        unsigned column;
+        State state;
+        TableBase::Checkpoint checkpoint;
+    };
+
+    TableType t;
+    TableType scratch;
+    std::vector<Edit> edits;
+    std::vector<Edit> replayedEdits;
+    std::vector<Change> changes;
+    std::vector<Change> droppedEdits;
+    // The cells rolled back by taking an edit back, with their states
+    // before, and a mark per position for telling them apart.
+    std::vector<Change> rolledBack;
+    std::vector<uint8_t> changeMarks;
+    Conflict conflict;
+    bool contradicted;
+
+public:
+    // The deductions that need no edit are made right away. If they already
+    // contradict, the board has no solution and every edit is refused.
+    explicit BoardEditor(const TableValues &values):
+        t(values),
+        changeMarks(values.size * values.size, 0),
+        conflict(t.applyPatterns()) {
+
+        if (conflict == Conflict::None) {
+            conflict = t.propagate();
+        }
+        contradicted = conflict != Conflict::None;
+    }
+
+    const TableType &getTable() const {
+        return t;
+    }
+
+    // The cells changed by the last setCell.
+    const std::vector<Change> &getChanges() const {
+        return changes;
+    }
+
+    // The later edits the last setCell dropped: taking an edit back makes
+    // them again, and these no longer applied. Their cells are left as the
+    // other edits have them, and are among the changes.
+    const std::vector<Change> &getDroppedEdits() const {
+        return droppedEdits;
+    }
+
+    // Why the last setCell was refused, None if it wasn't.
+    Conflict getConflict() const {
+        return conflict;
+    }
+
+    Status getStatus() const {
+        if (contradicted) {
+            return Status::Contradiction;
+        }
+        return t.isSolved() ? Status::Solved : Status::Consistent;
+    }
+
+    // Sets a cell to Final or Deleted, or takes its edit back with Unknown.
+    // A cell whose state was forced by the board or by other edits can't be
+    // flipped or made unknown, that is reported as a ForcedStateMismatch.
+    // On a contradiction the board is left as it was.
+    Status setCell(unsigned row, unsigned column, State state) {
+        changes.clear();
+        droppedEdits.clear();
+        conflict = Conflict::None;
+        if (contradicted) {
+            conflict = Conflict::ForcedStateMismatch;
+            return Status::Contradiction;
+        }
+
+        auto edit = edits.size();
+        for (auto i = 0U; i < edits.size(); i++) {
+            if (edits[i].row == row && edits[i].column == column) {
+                edit = i;
+                break;
+            }
+        }
+
+        const auto current = t.getCell(row, column).getState();
+        if (current == state) {
+            // Kept as an edit, so the cell stays put if what forced it is
+            // taken back.
+            if (state != State::Unknown && edit == edits.size()) {
+                edits.push_back({ row, column, state, t.getCheckpoint() });
+            }
+            return getStatus();
+        }
+        if (current != State::Unknown && edit == edits.size()) {
+            conflict = Conflict::ForcedStateMismatch;
+            return Status::Contradiction;
+        }
+
+        if (edit == edits.size()) {
+            const auto checkpoint = t.getCheckpoint();
+            if (!apply(row, column, state)) {
+                return Status::Contradiction;
+            }
+            t.forEachChangeSince(checkpoint, [&](unsigned r, unsigned c) {
+                changes.push_back({ r, c, t.getCell(r, c).getState() });
+            });
+            return getStatus();
+        }
+
+        // The cell's own edit is taken back: the board returns to its state
+        // before that edit, and the later edits are made again.
+        const auto checkpoint = edits[edit].checkpoint;
+        rolledBack.clear();
+        t.forEachChangeSince(checkpoint, [&](unsigned r, unsigned c) {
+            rolledBack.push_back({ r, c, t.getCell(r, c).getState() });
+        });
+        replayedEdits.assign(edits.begin() + edit, edits.end());
+        replay(checkpoint, edit, 1);
+
+        if (state != State::Unknown && !apply(row, column, state)) {
+            // Back to the edits as they were.
+            const auto newConflict = conflict;
+            replay(checkpoint, edit, 0);
+            conflict = newConflict;
+            return Status::Contradiction;
+        }
+
+        // Only the rolled back cells and the ones set since can differ, the
+        // latter were unknown before unless they were rolled back.
+        for (const auto &cell : rolledBack) {
+            const auto newState = t.getCell(cell.row, cell.column).getState();
+            if (newState != cell.state) {
+                changes.push_back({ cell.row, cell.column, newState });
+            }
+            changeMarks[cell.row * t.getSize() + cell.column] = 1;
+        }
+        t.forEachChangeSince(checkpoint, [&](unsigned r, unsigned c) {
+            if (changeMarks[r * t.getSize() + c] == 0) {
+                changes.push_back({ r, c, t.getCell(r, c).getState() });
+            }
+        });
+        for (const auto &cell : rolledBack) {
+            changeMarks[cell.row * t.getSize() + cell.column] = 0;
+        }
+        return getStatus();
+    }
+
+    // Searches for a solution from the current state, which stays as it is.
+    // The budget can bound the search, running out counts as unsolvable.
+    bool isSolvable(SearchBudget *budget = nullptr) {
+        if (contradicted) {
+            return false;
+        }
+        scratch = t;
+        return countSolutions(scratch, 1, nullptr, budget) != 0;
+    }
+
+    // The solution found by the last successful isSolvable.
+    const TableType &getSolution() const {
+        return scratch;
+    }
+
+private:
+    // Sets the cell and propagates, keeping it as an edit. On a conflict
+    // the board is rolled back and the conflict recorded.
+    bool apply(unsigned row, unsigned column, State state) {
+        const auto checkpoint = t.getCheckpoint();
+        if (t.getCell(row, column).getState() == state) {
+            edits.push_back({ row, column, state, checkpoint });
+            return true;
+        }
+        if (t.getCell(row, column).getState() != State::Unknown) {
+            conflict = Conflict::ForcedStateMismatch;
+            return false;
+        }
+
+        conflict = state == State::Deleted ? t.deleteCell(row, column) : t.finalizeCell(row, column);
+        if (conflict == Conflict::None) {
+            conflict = t.propagate();
+        }
+        if (conflict != Conflict::None) {
+            t.rollback(checkpoint);
+            return false;
+        }
+        edits.push_back({ row, column, state, checkpoint });
+        return true;
+    }
+
+    // Rolls back to the checkpoint of edits[edit] and makes the replayed
+    // edits from first on again. Edits that no longer apply are dropped,
+    // and listed in droppedEdits.
+    void replay(const TableBase::Checkpoint &checkpoint, size_t edit, size_t first) {
+        t.rollback(checkpoint);
+        edits.resize(edit);
+        droppedEdits.clear();
+        for (auto i = first; i < replayedEdits.size(); i++) {
+            const auto &replayed = replayedEdits[i];
+            if (!apply(replayed.row, replayed.column, replayed.state)) {
+                droppedEdits.push_back({ replayed.row, replayed.column, replayed.state });
+            }
+        }
+        conflict = Conflict::None;
+    }
+};
+
+// A deduction for a player's board: a cell, the state it must have and the
+// rule that shows it.
+struct Hint {
+    // In the order they are tried, which is by cost: the line and
+    // neighborhood rules take a pass over the board, connectivity a depth
+    // first search, trial a propagation per cell and search a full solve.
+    enum class Rule {
+        // No other copy of the value is left in the row and the column, so
+        // deleting the cell is never needed. This assumes the solution is
+        // unique, as the solver's own finalizeUniqueCells does.
+        Unique,
+        // A neighbor is deleted.
+        NeighborOfDeleted,
+        // The value is final elsewhere in the row or the column.
+        DuplicateOfFinal,
+        // In X?X the middle cell can't be deleted.
+        Sandwich,
+        // A line has XX next to each other, one of them stays.
+        Pair,
+        // The corner patterns of TableBase::applyPatterns.
+        Corner,
+        // Deleting the cell would cut the remaining cells in two.
+        Connectivity,
+        // The other state contradicts the board after propagation.
+        Trial,
+        // The state of the cell in a solution found by a search.
+        Search
+    };
+
+    unsigned row = 0;
+    unsigned column = 0;
+    TableBase::Cell::State state = TableBase::Cell::State::Unknown;
+    Rule rule = Rule::Unique;
+
+    static const char *getRuleName(Rule rule) {
+        switch (rule) {
+        case Rule::Unique:
+            return "unique";
+
+        case Rule::NeighborOfDeleted:
+            return "neighbor of deleted";
+
+        case Rule::DuplicateOfFinal:
+            return "duplicate of final";
+
+        case Rule::Sandwich:
+            return "sandwich";
+
+        case Rule::Pair:
+            return "pair";
+
+        case Rule::Corner:
+            return "corner";
+
+        case Rule::Connectivity:
+            return "connectivity";
+
+        case Rule::Trial:
+            return "trial";
+
+        case Rule::Search:
+            return "search";
+        }
+        return "unknown";
+    }
+};
+
+// Finds the next deduction for the board of a player, given by its values
+// and the states the player set. The rules look at the player's states as
+// they are, without propagating them first, so every hint can be explained
+// by its rule and the cells the player sees. The first rule that fires
+// gives the hint, so the common case costs a pass over the board. The
+// storage is kept between calls.
+class HintFinder {
+public:
+    using State = TableBase::Cell::State;
+
+private:
+    // Per line and value: the copies that aren't deleted, and whether one
+    // of them is final.
+    std::vector<unsigned> rowCounts, columnCounts;
+    std::vector<uint8_t> rowFinals, columnFinals;
+    // The depth first search of the connectivity rule.
+    std::vector<unsigned> order, low, parents, stack;
+    std::vector<uint8_t> nextNeighbor;
+
+public:
+    // Returns false if there is no hint: the board is complete, the
+    // player's states contradict it, or the search found no solution or
+    // ran out of its budget.
+    bool find(const TableValues &values, const std::vector<State> &states, Hint &hint, SearchBudget *budget = nullptr) {
+        const auto size = values.size;
+        if (size == 0 || values.values.size() != size * size || states.size() != size * size) {
+            throw TableBase::InvalidShapeException();
+        }
+
+        countLines(values, states);
+        return findLocal(values, states, hint) || findCorner(values, states, hint) ||
+            findCutCell(values, states, hint) || findByPropagation(values, states, hint, budget);
+    }
+
+private:
+    static unsigned lineIndex(unsigned size, unsigned line, unsigned value) {
+        return line * (size + 1) + value;
+    }
+
+    static bool setHint(Hint &hint, unsigned size, unsigned pos, State state, Hint::Rule rule) {
+        hint.row = pos / size;
+        hint.column = pos % size;
+        hint.state = state;
+        hint.rule = rule;
+        return true;
+    }
+
+    void countLines(const TableValues &values, const std::vector<State> &states) {
+        const auto size = values.size;
+        rowCounts.assign(size * (size + 1), 0);
+        columnCounts.assign(size * (size + 1), 0);
+        rowFinals.assign(size * (size + 1), 0);
+        columnFinals.assign(size * (size + 1), 0);
+        for (auto pos = 0U; pos < size * size; pos++) {
+            const auto value = values.values[pos];
+            if (value == 0 || value > size) {
+                throw TableBase::InvalidValueException();
+            }
+            if (states[pos] == State::Deleted) {
+                continue;
+            }
+            rowCounts[lineIndex(size, pos / size, value)]++;
+            columnCounts[lineIndex(size, pos % size, value)]++;
+            if (states[pos] == State::Final) {
+                rowFinals[lineIndex(size, pos / size, value)] = 1;
+                columnFinals[lineIndex(size, pos % size, value)] = 1;
+            }
+        }
+    }
+
+    // The rules that look at a cell's lines and neighbors, rule by rule in
+    // cost order.
+    bool findLocal(const TableValues &values, const std::vector<State> &states, Hint &hint) const {
+        const auto size = values.size;
+        const auto &v = values.values;
+        for (auto pos = 0U; pos < size * size; pos++) {
+            const auto row = lineIndex(size, pos / size, v[pos]);
+            const auto column = lineIndex(size, pos % size, v[pos]);
+            if (states[pos] == State::Unknown && rowCounts[row] == 1 && columnCounts[column] == 1) {
+                return setHint(hint, size, pos, State::Final, Hint::Rule::Unique);
+            }
+        }
+
+        for (auto pos = 0U; pos < size * size; pos++) {
+            const auto r = pos / size;
+            const auto c = pos % size;
+            if (states[pos] == State::Unknown &&
+                ((r > 0 && states[pos - size] == State::Deleted) || (r + 1 < size && states[pos + size] == State::Deleted) ||
+                 (c > 0 && states[pos - 1] == State::Deleted) || (c + 1 < size && states[pos + 1] == State::Deleted))) {
+                return setHint(hint, size, pos, State::Final, Hint::Rule::NeighborOfDeleted);
+            }
+        }
+
+        for (auto pos = 0U; pos < size * size; pos++) {
+            if (states[pos] == State::Unknown &&
+                (rowFinals[lineIndex(size, pos / size, v[pos])] != 0 || columnFinals[lineIndex(size, pos % size, v[pos])] != 0)) {
+                return setHint(hint, size, pos, State::Deleted, Hint::Rule::DuplicateOfFinal);
+            }
+        }
+
+        // Lines as a first cell and a step, rows then columns.
+        for (auto line = 0U; line < 2 * size; line++) {
+            const auto first = line < size ? line * size : line - size;
+            const auto step = line < size ? 1 : size;
+            for (auto i = 1U; i + 1 < size; i++) {
+                const auto pos = first + i * step;
+                if (states[pos] == State::Unknown && v[pos - step] == v[pos + step]) {
+                    return setHint(hint, size, pos, State::Final, Hint::Rule::Sandwich);
+                }
+            }
+        }
+
+        for (auto line = 0U; line < 2 * size; line++) {
+            const auto first = line < size ? line * size : line - size;
+            const auto step = line < size ? 1 : size;
+            for (auto i = 0U; i + 1 < size; i++) {
+                const auto value = v[first + i * step];
+                if (v[first + (i + 1) * step] != value) {
+                    continue;
+                }
+                for (auto j = 0U; j < size; j++) {
+                    const auto pos = first + j * step;
+                    if (j != i && j != i + 1 && v[pos] == value && states[pos] == State::Unknown) {
+                        return setHint(hint, size, pos, State::Deleted, Hint::Rule::Pair);
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    bool findCorner(const TableValues &values, const std::vector<State> &states, Hint &hint) const {
+        const auto size = values.size;
+        const auto &v = values.values;
+        if (size < 2) {
+            return false;
+        }
+
+        const unsigned corners[4][2] = { { 0, 0 }, { 0, size - 1 }, { size - 1, 0 }, { size - 1, size - 1 } };
+        for (const auto &corner : corners) {
+            const auto row = corner[0];
+            const auto column = corner[1];
+            const auto cornerPos = row * size + column;
+            const auto rowNeighborPos = row * size + (column == 0 ? 1 : size - 2);
+            const auto columnNeighborPos = (row == 0 ? 1 : size - 2) * size + column;
+            const auto oppositePos = columnNeighborPos + rowNeighborPos - cornerPos;
+
+            const auto cornerValue = v[cornerPos];
+            const auto rowPair = v[rowNeighborPos] == cornerValue && v[columnNeighborPos] == v[oppositePos];
+            const auto columnPair = v[columnNeighborPos] == cornerValue && v[rowNeighborPos] == v[oppositePos];
+            const auto cornerDeleted = rowPair || columnPair ||
+                (v[rowNeighborPos] == cornerValue && v[columnNeighborPos] == cornerValue);
+            if (cornerDeleted && states[cornerPos] == State::Unknown) {
+                return setHint(hint, size, cornerPos, State::Deleted, Hint::Rule::Corner);
+            }
+            if ((rowPair || columnPair) && states[oppositePos] == State::Unknown) {
+                return setHint(hint, size, oppositePos, State::Deleted, Hint::Rule::Corner);
+            }
+        }
+        return false;
+    }
+
+    // An unknown cell that is an articulation point of the cells that aren't
+    // deleted, found by an iterative depth first search keeping the lowest
+    // discovery order reachable from every subtree.
+    bool findCutCell(const TableValues &values, const std::vector<State> &states, Hint &hint) {
+        const auto size = values.size;
+        const auto cellCount = size * size;
+        const auto none = ~0U;
+        auto root = 0U;
+        while (root < cellCount && states[root] == State::Deleted) {
+            root++;
+        }
+        if (root == cellCount) {
+            return false;
+        }
+
+        order.assign(cellCount, none);
+        low.assign(cellCount, 0);
+        parents.assign(cellCount, none);
+        nextNeighbor.assign(cellCount, 0);
+        stack.clear();
+
+        const auto getNeighbor = [&](unsigned pos, unsigned index) {
+            const auto r = pos / size;
+            const auto c = pos % size;
+            switch (index) {
+            case 0:
+                return r > 0 ? pos - size : none;
+
+            case 1:
+                return c + 1 < size ? pos + 1 : none;
+
+            case 2:
+                return r + 1 < size ? pos + size : none;
+
+            default:
+                return c > 0 ? pos - 1 : none;
+            }
+        };
+
+        auto counter = 0U;
+        auto rootChildren = 0U;
+        order[root] = low[root] = counter++;
+        stack.push_back(root);
+        while (!stack.empty()) {
+            const auto pos = stack.back();
+            if (nextNeighbor[pos] < 4) {
+                const auto neighbor = getNeighbor(pos, nextNeighbor[pos]++);
+                if (neighbor == none || states[neighbor] == State::Deleted) {
+                    continue;
+                }
+                if (order[neighbor] == none) {
+                    parents[neighbor] = pos;
+                    order[neighbor] = low[neighbor] = counter++;
+                    stack.push_back(neighbor);
+                    rootChildren += pos == root ? 1 : 0;
+                } else if (neighbor != parents[pos]) {
+                    low[pos] = std::min(low[pos], order[neighbor]);
+                }
+                continue;
+            }
+
+            stack.pop_back();
+            const auto parent = parents[pos];
+            if (parent == none) {
+                continue;
+            }
+            low[parent] = std::min(low[parent], low[pos]);
+            if (parent != root && low[pos] >= order[parent] && states[parent] == State::Unknown) {
+                return setHint(hint, size, parent, State::Final, Hint::Rule::Connectivity);
+            }
+        }
+        if (rootChildren > 1 && states[root] == State::Unknown) {
+            return setHint(hint, size, root, State::Final, Hint::Rule::Connectivity);
+        }
+        return false;
+    }
+
+    // Sets the player's states on a table, then tries both states of every
+    // unknown cell; the cheap rules found nothing, so propagating the
+    // player's states adds no cells of its own. Searches if that fails too.
+    bool findByPropagation(const TableValues &values, const std::vector<State> &states, Hint &hint, SearchBudget *budget) const {
+        const auto size = values.size;
+        auto found = false;
+        visitTableType(size, [&](auto tableType) {
+            using TableType = typename decltype(tableType)::type;
+            auto &t = ThreadWorkspace<TableType>::get().table;
+            t.reset(values);
+            for (auto pos = 0U; pos < size * size; pos++) {
+                const auto current = t.getCell(pos / size, pos % size).getState();
+                if (states[pos] == State::Unknown || states[pos] == current) {
+                    continue;
+                }
+                if (current != State::Unknown) {
+                    return;
+                }
+                const auto conflict = states[pos] == State::Deleted
+                    ? t.deleteCell(pos / size, pos % size)
+                    : t.finalizeCell(pos / size, pos % size);
+                if (conflict != TableBase::Conflict::None) {
+                    return;
+                }
+            }
+            if (t.propagate() != TableBase::Conflict::None) {
+                return;
+            }
+
+            const auto contradicts = [&](unsigned pos, State state) {
+                const auto checkpoint = t.getCheckpoint();
+                auto conflict = state == State::Deleted
+                    ? t.deleteCell(pos / size, pos % size)
+                    : t.finalizeCell(pos / size, pos % size);
+                if (conflict == TableBase::Conflict::None) {
+                    conflict = t.propagate();
+                }
+                t.rollback(checkpoint);
+                return conflict != TableBase::Conflict::None;
+            };
+            for (auto pos = 0U; pos < size * size && !found; pos++) {
+                if (states[pos] != State::Unknown || t.getCell(pos / size, pos % size).getState() != State::Unknown) {
+                    continue;
+                }
+                if (contradicts(pos, State::Deleted)) {
+                    found = setHint(hint, size, pos, State::Final, Hint::Rule::Trial);
+                } else if (contradicts(pos, State::Final)) {
+                    found = setHint(hint, size, pos, State::Deleted, Hint::Rule::Trial);
+                }
+            }
+            if (found || countSolutions(t, 1, nullptr, budget) == 0) {
+                return;
+            }
+
+            for (auto pos = 0U; pos < size * size && !found; pos++) {
+                if (states[pos] == State::Unknown) {
+                    found = setHint(hint, size, pos, t.getCell(pos / size, pos % size).getState(), Hint::Rule::Search);
+                }
+            }
+        });
+        return found;
+    }
+};
+
+// A fixed set of threads running the submitted jobs in submission order.
+// The destructor waits for the queued jobs to finish.
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::deque<std::function<void()>> jobs;
+    bool stopping;
+
+public:
+    ThreadPool(unsigned threadCount):
+        stopping(false) {
+
+        for (auto i = 0U; i < threadCount; i++) {
+            workers.emplace_back([this]() {
+                work();
+            });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        jobAvailable.notify_all();
+
+        for (auto &worker : workers) {
+            worker.join();
+        }
+    }
+
+    void submit(std::function<void()> job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(std::move(job));
+        }
+        jobAvailable.notify_one();
+    }
+
+private:
+    void work() {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobAvailable.wait(lock, [this]() {
+                    return stopping || !jobs.empty();
+                });
+                if (jobs.empty()) {
+                    return;
+                }
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+        }
+    }
+};
+
+// Caches search results by the canonical form of the board: the least of
+// its 8 symmetric copies under rotation and reflection, with the values
+// renumbered in the order they first appear. The rules don't depend on
+// either, so all these copies share an entry, and its solution is mapped
+// back to the board asked for. An entry answers searches with any solution
+// limit its count settles, from whichever backend: they all count the
+// minimal solutions. The entries are spread over shards, each with a lock
+// and its own least recently used order for eviction.
+class SolveCache {
+public:
+    struct Stats {
+        unsigned long long hits = 0;
+        unsigned long long misses = 0;
+        unsigned long long evictions = 0;
+        size_t size = 0;
+        size_t capacity = 0;
+    };
+
+private:
+    static constexpr unsigned ShardCount = 16;
+
+    // A board in canonical form, and the symmetry that maps it there.
+    struct Canonical {
+        std::vector<uint8_t> values;
+        unsigned symmetry = 0;
+        uint64_t hash = 0;
+    };
+
+    struct Entry {
+        uint64_t hash;
+        unsigned size;
+        std::vector<uint8_t> values;
+        unsigned long long solutionCount;
+        bool exhaustive;
+        // The deleted cells of a solution in canonical form, packed.
+        std::vector<uint8_t> mask;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        // Most recently used first.
+        std::list<Entry> entries;
+        std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+    };
+
+    size_t shardCapacity;
+    std::unique_ptr<Shard[]> shards;
+    std::atomic<unsigned long long> hits, misses, evictions;
+
+public:
+    SolveCache(size_t capacity):
+        shardCapacity(std::max<size_t>((capacity + ShardCount - 1) / ShardCount, 1)),
+        shards(new Shard[ShardCount]),
+        hits(0),
+        misses(0),
+        evictions(0) { }
+
+    // Looks up the result of a search of values for at most limit
+    // solutions. On a hit the count and exhaustive are set as that search
+    // would set them, and deleted to one byte per cell of a solution if
+    // there is any.
+    bool lookup(const TableValues &values, unsigned long long limit, unsigned long long &solutionCount, bool &exhaustive,
+                std::vector<uint8_t> &deleted) {
+        Canonical canonical;
+        if (!canonicalize(values, canonical)) {
+            return false;
+        }
+
+        auto &shard = getShard(canonical.hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        const auto found = shard.index.find(canonical.hash);
+        if (found == shard.index.end() || found->second->values != canonical.values ||
+            (!found->second->exhaustive && found->second->solutionCount < limit)) {
+            misses.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+
+        const auto &entry = *found->second;
+        solutionCount = std::min(entry.solutionCount, limit);
+        exhaustive = entry.exhaustive && entry.solutionCount < limit;
+        deleted.clear();
+        if (entry.solutionCount != 0) {
+            const auto size = values.size;
+            deleted.resize(size * size);
+            for (auto pos = 0U; pos < size * size; pos++) {
+                deleted[getSourcePos(canonical.symmetry, pos / size, pos % size, size)] =
+                    static_cast<uint8_t>(CorpusFormat::unpack(entry.mask.data(), pos, 1));
+            }
+        }
+        hits.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Stores the result of a search of values, deleted holds one byte per
+    // cell of the first solution. An entry that settles more is kept.
+    void insert(const TableValues &values, unsigned long long solutionCount, bool exhaustive, const std::vector<uint8_t> &deleted) {
+        Canonical canonical;
+        if (!canonicalize(values, canonical) || (solutionCount != 0 && deleted.size() != values.values.size())) {
+            return;
+        }
+
+        const auto size = values.size;
+        Entry entry{ canonical.hash, size, std::move(canonical.values), solutionCount, exhaustive, {} };
+        if (solutionCount != 0) {
+            std::vector<uint8_t> canonicalDeleted(size * size);
+            for (auto pos = 0U; pos < size * size; pos++) {
+                canonicalDeleted[pos] = deleted[getSourcePos(canonical.symmetry, pos / size, pos % size, size)];
+            }
+            CorpusFormat::pack(entry.mask, canonicalDeleted.data(), canonicalDeleted.size(), 1);
+        }
+
+        auto &shard = getShard(entry.hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        const auto found = shard.index.find(entry.hash);
+        if (found != shard.index.end()) {
+            auto &old = *found->second;
+            if (old.values == entry.values &&
+                (old.exhaustive || (!entry.exhaustive && old.solutionCount >= entry.solutionCount))) {
+                shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+                return;
+            }
+            shard.entries.erase(found->second);
+            shard.index.erase(found);
+        }
+
+        shard.entries.push_front(std::move(entry));
+        shard.index[shard.entries.front().hash] = shard.entries.begin();
+        if (shard.entries.size() > shardCapacity) {
+            shard.index.erase(shard.entries.back().hash);
+            shard.entries.pop_back();
+            evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    Stats getStats() {
+        Stats stats;
+        stats.hits = hits.load(std::memory_order_relaxed);
+        stats.misses = misses.load(std::memory_order_relaxed);
+        stats.evictions = evictions.load(std::memory_order_relaxed);
+        stats.capacity = shardCapacity * ShardCount;
+        for (auto i = 0U; i < ShardCount; i++) {
+            std::lock_guard<std::mutex> lock(shards[i].mutex);
+            stats.size += shards[i].entries.size();
+        }
+        return stats;
+    }
+
+    // The cache is stored as a binary corpus of the canonical boards and
+    // their results, so it can be read back by load and by CorpusReader.
+    void load(std::istream &in) {
+        CorpusReader reader(in);
+        TableValues values;
+        SolveResult result;
+        std::vector<uint8_t> deleted;
+        for (size_t i = 0; i < reader.getRecordCount(); i++) {
+            if (!reader.read(i, values, &result) || result.timedOut || !result.error.empty()) {
+                continue;
+            }
+            deleted.clear();
+            if (result.solutionCount != 0) {
+                for (size_t pos = 0; pos < values.values.size(); pos++) {
+                    deleted.push_back(static_cast<uint8_t>(CorpusFormat::unpack(result.solutionMask.data(), pos, 1)));
+                }
+            }
+            insert(values, result.solutionCount, result.exhaustive, deleted);
+        }
+    }
+
+    // Writes the least recently used entries first, so load restores the
+    // order.
+    void save(std::ostream &out) {
+        CorpusWriter writer(out);
+        TableValues values;
+        SolveResult result;
+        for (auto i = 0U; i < ShardCount; i++) {
+            std::lock_guard<std::mutex> lock(shards[i].mutex);
+            for (auto entry = shards[i].entries.rbegin(); entry != shards[i].entries.rend(); ++entry) {
+                values.size = entry->size;
+                values.values.assign(entry->values.begin(), entry->values.end());
+                result.solutionCount = entry->solutionCount;
+                result.exhaustive = entry->exhaustive;
+                result.solutionMask = entry->mask;
+                writer.write(values, &result);
+            }
+        }
+        writer.finish();
+    }
+
+private:
+    Shard &getShard(uint64_t hash) {
+        return shards[hash % ShardCount];
+    }
+
+    // The cell of a board that symmetry maps to row, column: bit 0 swaps
+    // rows and columns, bits 1 and 2 then mirror the rows and the columns.
+    static unsigned getSourcePos(unsigned symmetry, unsigned row, unsigned column, unsigned size) {
+        if ((symmetry & 1) != 0) {
+            std::swap(row, column);
+        }
+        if ((symmetry & 2) != 0) {
+            row = size - 1 - row;
+        }
+        if ((symmetry & 4) != 0) {
+            column = size - 1 - column;
+        }
+        return row * size + column;
+    }
+
+    // Returns false for a board that can't be solved as is, so the search
+    // reports its error.
+    static bool canonicalize(const TableValues &values, Canonical &canonical) {
+        const auto size = values.size;
+        if (size == 0 || size > TableBase::MaxSize || values.values.size() != size * size) {
+            return false;
+        }
+        for (const auto value : values.values) {
+            if (value == 0 || value > size) {
+                return false;
+            }
+        }
+
+        // The copies are renumbered as they are compared, a copy is dropped
+        // at the first cell it is greater than the least one so far in.
+        std::vector<uint8_t> labels(size + 1);
+        std::vector<uint8_t> copy(size * size);
+        for (auto symmetry = 0U; symmetry < 8; symmetry++) {
+            std::fill(labels.begin(), labels.end(), 0);
+            auto nextLabel = 0U;
+            auto less = symmetry == 0;
+            auto pos = 0U;
+            for (; pos < size * size; pos++) {
+                auto &label = labels[values.values[getSourcePos(symmetry, pos / size, pos % size, size)]];
+                if (label == 0) {
+                    label = static_cast<uint8_t>(++nextLabel);
+                }
+                copy[pos] = label;
+                if (!less) {
+                    if (label > canonical.values[pos]) {
+                        break;
+                    }
+                    less = label < canonical.values[pos];
+                }
+            }
+            if (pos == size * size && less) {
+                canonical.values.swap(copy);
+                canonical.symmetry = symmetry;
+                copy.resize(size * size);
+            }
+        }
+
+        canonical.hash = hashBytes(canonical.values.data(), canonical.values.size(), size);
+        return true;
+    }
+};
+
+// A way of searching a table for its solutions, picked by
+// SolveOptions::backend.
+class SolverBackend {
+public:
+    using State = TableBase::Cell::State;
+
+    virtual ~SolverBackend() = default;
+
+    // Counts the solutions of the table, stopping at limit, within the
+    // budget. states gets the cells of the first solution found or, if
+    // there is none, the states known for sure. The work done is added to
+    // stats.
+    virtual unsigned long long countSolutions(const TableValues &values, unsigned long long limit,
+                                              std::vector<State> &states, SearchStats &stats,
+                                              SearchBudget &budget) = 0;
+};
+
+// The depth-first search over the Table propagation, on threadCount
+// threads.
+class SearchBackend : public SolverBackend {
+private:
+    unsigned threadCount;
+    bool learnNogoods;
+
+public:
+    SearchBackend(unsigned threadCount, bool learnNogoods):
+        threadCount(threadCount),
+        learnNogoods(learnNogoods) { }
+
+    unsigned long long countSolutions(const TableValues &values, unsigned long long limit,
+                                      std::vector<State> &states, SearchStats &stats,
+                                      SearchBudget &budget) override {
+        auto count = 0ULL;
+        visitTableType(values.size, [&](auto tableType) {
+            using TableType = typename decltype(tableType)::type;
+            auto &t = ThreadWorkspace<TableType>::get().table;
+            t.reset(values);
+            count = threadCount > 1
+                ? ParallelSolver<TableType>(threadCount).countSolutions(t, limit, &stats, &budget)
+                : ::countSolutions(t, limit, &stats, &budget, learnNogoods);
+
+            states.clear();
+            states.reserve(values.values.size());
+            for (const auto &row : t) {
+                for (const auto &cell : row) {
+                    states.push_back(cell.getState());
+                }
+            }
+        });
+        return count;
+    }
+};
+
+// Solves tables as CNF with the SatSolver. A cell's variable is true where
+// the cell is deleted. The clauses say that:
+// - two copies of a value in a line aren't both final
+// - neighbors aren't both deleted
+// - a final cell has a final neighbor
+// - a deleted cell has a final copy of its value in its row or column
+//
+// The last clause gives the minimal solutions, see Table::isMinimal, so the
+// counts agree with the search's.
+//
+// Connectivity of the final cells is added lazily. When a model splits them
+// into parts, every part but the largest gets a cut clause: one of the
+// deleted cells around the part is final, or a cell of the part or of the
+// largest part is deleted. The solver goes on from there, keeping what it
+// learned. The solver's decisions count as nodes, its conflicts as
+// branch points.
+class SatBackend : public SolverBackend {
+private:
+    using Literal = SatSolver::Literal;
+
+    static constexpr unsigned NoComponent = ~0U;
+
+    SatSolver solver;
+    std::vector<Literal> clause;
+    // The part of the final cells every cell is in, and the scratch of
+    // finding them.
+    std::vector<unsigned> components;
+    std::vector<unsigned> componentSizes;
+    std::vector<unsigned> componentCells;
+    std::vector<unsigned> stack;
+    std::vector<unsigned> boundaryMarks;
+
+public:
+    // The backend of the calling thread, whose storage is reused.
+    static SatBackend &get() {
+        thread_local SatBackend backend;
+        return backend;
+    }
+
+    unsigned long long countSolutions(const TableValues &values, unsigned long long limit,
+                                      std::vector<State> &states, SearchStats &stats,
+                                      SearchBudget &budget) override {
+        const auto cellCount = static_cast<unsigned>(values.values.size());
+        solver.reset(cellCount);
+        auto solvable = encode(values);
+        states.assign(cellCount, State::Unknown);
+
+        auto count = 0ULL;
+        while (solvable && count < limit) {
+            const auto result = solver.solve([&](unsigned long long decisions) {
+                return budget.charge(decisions);
+            });
+            if (result != SatSolver::Result::Satisfiable) {
+                break;
+            }
+            if (!findComponents(values.size)) {
+                solvable = addCuts(values.size);
+                continue;
+            }
+
+            if (count++ == 0) {
+                for (auto pos = 0U; pos < cellCount; pos++) {
+                    states[pos] = solver.getModelValue(pos) ? State::Deleted : State::Final;
+                }
+            }
+            // A solution can't delete a superset of another's cells, so
+            // ruling out its deleted set rules out only this one.
+            clause.clear();
+            for (auto pos = 0U; pos < cellCount; pos++) {
+                if (solver.getModelValue(pos)) {
+                    clause.push_back(SatSolver::makeLiteral(pos, false));
+                }
+            }
+            solvable = solver.addClause(clause);
+        }
+
+        if (count == 0) {
+            for (auto pos = 0U; pos < cellCount; pos++) {
+                switch (solver.getFixedValue(pos)) {
+                case SatSolver::True:
+                    states[pos] = State::Deleted;
+                    break;
+
+                case SatSolver::False:
+                    states[pos] = State::Final;
+                    break;
+
+                case SatSolver::Unassigned:
+                    break;
+                }
+            }
+        }
+        stats.nodes += solver.getDecisionCount();
+        stats.branchPoints += solver.getConflictCount();
+        return count;
+    }
+
+private:
+    bool addBinary(Literal a, Literal b) {
+        clause.assign({ a, b });
+        return solver.addClause(clause);
+    }
+
+    bool encode(const TableValues &values) {
+        const auto size = values.size;
+        const auto deleted = [](unsigned pos) {
+            return SatSolver::makeLiteral(pos, true);
+        };
+        const auto final = [](unsigned pos) {
+            return SatSolver::makeLiteral(pos, false);
+        };
+
+        auto solvable = true;
+        for (auto row = 0U; row < size && solvable; row++) {
+            for (auto column = 0U; column < size && solvable; column++) {
+                const auto pos = row * size + column;
+                const auto value = values.values[pos];
+
+                // The later copies in the row and the column, and this
+                // cell's copies for the deleted cell's clause.
+                clause.assign(1, final(pos));
+                for (auto i = 0U; i < size; i++) {
+                    if (i != column && values.values[row * size + i] == value) {
+                        clause.push_back(final(row * size + i));
+                    }
+                    if (i != row && values.values[i * size + column] == value) {
+                        clause.push_back(final(i * size + column));
+                    }
+                }
+                solvable = solver.addClause(clause);
+                for (auto i = column + 1; i < size && solvable; i++) {
+                    if (values.values[row * size + i] == value) {
+                        solvable = addBinary(deleted(pos), deleted(row * size + i));
+                    }
+                }
+                for (auto i = row + 1; i < size && solvable; i++) {
+                    if (values.values[i * size + column] == value) {
+                        solvable = addBinary(deleted(pos), deleted(i * size + column));
+                    }
+                }
+
+                if (column + 1 < size && solvable) {
+                    solvable = addBinary(final(pos), final(pos + 1));
+                }
+                if (row + 1 < size && solvable) {
+                    solvable = addBinary(final(pos), final(pos + size));
+                }
+
+                if (size > 1 && solvable) {
+                    clause.assign(1, deleted(pos));
+                    forEachNeighbor(size, pos, [&](unsigned neighbor) {
+                        clause.push_back(final(neighbor));
+                    });
+                    solvable = solver.addClause(clause);
+                }
+            }
+        }
+        return solvable;
+    }
+
+    template <typename OnNeighbor>
+    static void forEachNeighbor(unsigned size, unsigned pos, OnNeighbor &&onNeighbor) {
+        const auto row = pos / size;
+        const auto column = pos % size;
+        if (row > 0) {
+            onNeighbor(pos - size);
+        }
+        if (row + 1 < size) {
+            onNeighbor(pos + size);
+        }
+        if (column > 0) {
+            onNeighbor(pos - 1);
+        }
+        if (column + 1 < size) {
+            onNeighbor(pos + 1);
+        }
+    }
+
+    // Labels the parts of the final cells of the model. Returns whether
+    // there is at most one.
+    bool findComponents(unsigned size) {
+        const auto cellCount = size * size;
+        components.assign(cellCount, NoComponent);
+        componentSizes.clear();
+        componentCells.clear();
+        for (auto start = 0U; start < cellCount; start++) {
+            if (components[start] != NoComponent || solver.getModelValue(start)) {
+                continue;
+            }
+            const auto id = static_cast<unsigned>(componentSizes.size());
+            componentSizes.push_back(0);
+            componentCells.push_back(start);
+            components[start] = id;
+            stack.assign(1, start);
+            while (!stack.empty()) {
+                const auto pos = stack.back();
+                stack.pop_back();
+                componentSizes[id]++;
+                forEachNeighbor(size, pos, [&](unsigned neighbor) {
+                    if (components[neighbor] == NoComponent && !solver.getModelValue(neighbor)) {
+                        components[neighbor] = id;
+                        stack.push_back(neighbor);
+                    }
+                });
+            }
+        }
+        return componentSizes.size() <= 1;
+    }
+
+    // Adds a cut clause for every part but the largest. Returns false if
+    // the solver became unsatisfiable.
+    bool addCuts(unsigned size) {
+        const auto cellCount = size * size;
+        const auto largest = static_cast<unsigned>(
+            std::max_element(componentSizes.begin(), componentSizes.end()) - componentSizes.begin());
+        boundaryMarks.assign(cellCount, NoComponent);
+
+        std::vector<std::vector<Literal>> cuts(componentSizes.size());
+        for (auto pos = 0U; pos < cellCount; pos++) {
+            const auto id = components[pos];
+            if (id == NoComponent || id == largest) {
+                continue;
+            }
+            forEachNeighbor(size, pos, [&](unsigned neighbor) {
+                if (components[neighbor] == NoComponent && boundaryMarks[neighbor] != id) {
+                    boundaryMarks[neighbor] = id;
+                    cuts[id].push_back(SatSolver::makeLiteral(neighbor, false));
+                }
+            });
+        }
+
+        for (auto id = 0U; id < cuts.size(); id++) {
+            if (id == largest) {
+                continue;
+            }
+            cuts[id].push_back(SatSolver::makeLiteral(componentCells[id], true));
+            cuts[id].push_back(SatSolver::makeLiteral(componentCells[largest], true));
+            if (!solver.addClause(cuts[id])) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+enum class SolveMode {
+    // Find a solution.
+    First,
+    // Count every solution.
+    Count,
+    // Find the solution and check that it is the only one.
+    Unique
+};
+
+enum class SolverBackendKind {
+    // The depth-first search, see SearchBackend.
+    Search,
+    // The SAT encoding, see SatBackend.
+    Sat,
+    // The search for small boards. Boards of at least autoMinSize are
+    // searched until autoProbeNodes nodes, and handed to the SAT backend if
+    // that wasn't enough.
+    Auto
+};
+
+enum class OutputFormat {
+    // The solved grid as text.
+    Text,
+    // Records of a binary corpus, see CorpusFormat.
+    Binary
+};
+
+struct SolveOptions {
+    SolveMode mode = SolveMode::First;
+    unsigned threadCount = 1;
+    OutputFormat format = OutputFormat::Text;
+    TableFormatter::Style style = TableFormatter::Style::Grid;
+    // Limits of the search of a table, 0 and null mean none. The time limit
+    // counts from the start of solveTable.
+    std::chrono::milliseconds timeLimit = std::chrono::milliseconds::zero();
+    unsigned long long nodeLimit = 0;
+    const CancellationToken *cancellationToken = nullptr;
+    // Results are looked up in and added to the cache, if there is one.
+    SolveCache *cache = nullptr;
+    // Learn nogoods in sequential searches, see NogoodLearner.
+    bool learnNogoods = false;
+    SolverBackendKind backend = SolverBackendKind::Search;
+    unsigned autoMinSize = 30;
+    unsigned long long autoProbeNodes = 1 << 14;
+};
+
+// Solves a table: finds the solution, the number of solutions in Count
+// mode, or the reason there is no (unique) solution. The result is only
+// rendered as text for Text output. A result taken from the cache has no
+// search stats.
+inline SolveResult solveTable(const TableValues &values, const SolveOptions &options) {
+    auto limit = 1ULL;
+    if (options.mode == SolveMode::Count) {
+        limit = ~0ULL;
+    } else if (options.mode == SolveMode::Unique) {
+        limit = 2;
+    }
+
+    SolveResult result;
+    std::vector<uint8_t> deleted;
+    const auto cached = options.cache != nullptr &&
+        options.cache->lookup(values, limit, result.solutionCount, result.exhaustive, deleted);
+    if (!cached) {
+        const auto start = SearchBudget::Clock::now();
+        const auto setUpBudget = [&](SearchBudget &budget, unsigned long long nodeLimit) {
+            if (options.timeLimit != std::chrono::milliseconds::zero()) {
+                budget.setDeadline(start + options.timeLimit);
+            }
+            budget.setNodeLimit(nodeLimit);
+            budget.setCancellationToken(options.cancellationToken);
+        };
+        SearchBudget budget;
+        setUpBudget(budget, options.nodeLimit);
+
+        std::vector<TableBase::Cell::State> states;
+        SearchBackend searchBackend(options.threadCount, options.learnNogoods);
+        switch (options.backend) {
+        case SolverBackendKind::Search:
+            result.solutionCount = searchBackend.countSolutions(values, limit, states, result.stats, budget);
+            break;
+
+        case SolverBackendKind::Sat:
+            result.solutionCount = SatBackend::get().countSolutions(values, limit, states, result.stats, budget);
+            break;
+
+        case SolverBackendKind::Auto: {
+            // Small boards, and the boards the probe settles, stay with the
+            // search; so do the searches the caller's limits stopped.
+            const auto probing = values.size >= options.autoMinSize &&
+                (options.nodeLimit == 0 || options.nodeLimit > options.autoProbeNodes);
+            SearchBudget probe;
+            setUpBudget(probe, options.autoProbeNodes);
+            auto &searchBudget = probing ? probe : budget;
+            result.solutionCount = searchBackend.countSolutions(values, limit, states, result.stats, searchBudget);
+            const auto stopped = (options.cancellationToken != nullptr && options.cancellationToken->isCancelled()) ||
+                (options.timeLimit != std::chrono::milliseconds::zero() &&
+                 SearchBudget::Clock::now() >= start + options.timeLimit);
+            if (!probing || !probe.isExhausted() || stopped) {
+                result.timedOut = searchBudget.isExhausted();
+                break;
+            }
+
+            if (options.nodeLimit != 0) {
+                budget.setNodeLimit(options.nodeLimit - options.autoProbeNodes);
+            }
+            result.solutionCount = SatBackend::get().countSolutions(values, limit, states, result.stats, budget);
+            break;
+        }
+        }
+        result.timedOut = result.timedOut || budget.isExhausted();
+        result.exhaustive = result.solutionCount < limit && !result.timedOut;
+
+        if (result.solutionCount != 0) {
+            deleted.reserve(states.size());
+            for (const auto state : states) {
+                deleted.push_back(state == TableBase::Cell::State::Deleted ? 1 : 0);
+            }
+        }
+
+        if (result.timedOut && options.format == OutputFormat::Text) {
+            // The board is the first solution found or the deductions made.
+            result.text = "Timed out";
+            if (result.solutionCount != 0) {
+                result.text += ", solutions found: " + std::to_string(result.solutionCount);
+            }
+            result.text += '\n';
+            TableFormatter::append(result.text, values, states, options.style);
+        }
+
+        if (options.cache != nullptr && !result.timedOut) {
+            options.cache->insert(values, result.solutionCount, result.exhaustive, deleted);
+        }
+    }
+
+    result.success = result.solutionCount != 0 && !result.timedOut &&
+        !(options.mode == SolveMode::Unique && result.solutionCount > 1);
+    if (result.solutionCount != 0) {
+        CorpusFormat::pack(result.solutionMask, deleted.data(), deleted.size(), 1);
+    }
+
+    if (options.format != OutputFormat::Text || result.timedOut) {
+        return result;
+    }
+
+    if (options.mode == SolveMode::Count) {
+        result.text = "Solutions: " + std::to_string(result.solutionCount) + '\n';
+
+    } else if (result.solutionCount == 0) {
+        result.text = "No solution exists\n";
+
+    } else if (!result.success) {
+        result.text = "Multiple solutions exist\n";
+
+    } else {
+        TableFormatter::append(result.text, values, deleted, options.style);
+    }
+    return result;
+}
+
+// Generates a size x size table that has at least one solution: a shuffled
+// latin square in which a random set of cells, kept apart and leaving the
+// rest connected, is overwritten with values of their lines. The set is
+// stored in shading, one char per cell, if it isn't null.
+inline TableValues generateTable(unsigned size, std::mt19937_64 &random, std::vector<char> *shading = nullptr) {
+    TableValues table;
+    table.size = size;
+    table.values.resize(size * size);
+
+    std::vector<unsigned> values(size), rows(size), columns(size);
+    for (auto i = 0U; i < size; i++) {
+        values[i] = i + 1;
+        rows[i] = i;
+        columns[i] = i;
+    }
+    std::shuffle(values.begin(), values.end(), random);
+    std::shuffle(rows.begin(), rows.end(), random);
+    std::shuffle(columns.begin(), columns.end(), random);
+    for (auto row = 0U; row < size; row++) {
+        for (auto column = 0U; column < size; column++) {
+            table.values[row * size + column] = values[(rows[row] + columns[column]) % size];
+        }
+    }
+
+    std::vector<unsigned> cells(size * size);
+    for (auto pos = 0U; pos < size * size; pos++) {
+        cells[pos] = pos;
+    }
+    std::shuffle(cells.begin(), cells.end(), random);
+    cells.resize(size * size / 3);
+
+    // The latin square has no duplicates, so on a Table of it deleteCell
+    // only checks the shading: it finalizes the neighbors of a deleted
+    // cell, and refuses to close a loop of deleted cells.
+    std::vector<char> deleted(size * size, 0);
+    if (!cells.empty()) {
+        visitTableType(size, [&](auto tableType) {
+            using TableType = typename decltype(tableType)::type;
+            auto &t = ThreadWorkspace<TableType>::get().table;
+            t.reset(table);
+            for (const auto pos : cells) {
+                const auto row = pos / size;
+                const auto column = pos % size;
+                if (t.getCell(row, column).getState() != TableBase::Cell::State::Unknown) {
+                    continue;
+                }
+
+                const auto checkpoint = t.getCheckpoint();
+                if (t.deleteCell(row, column) == TableBase::Conflict::None) {
+                    deleted[pos] = 1;
+                } else {
+                    t.rollback(checkpoint);
+                }
+            }
+        });
+    }
+
+    // A deleted cell takes the value of a kept cell in its row or column.
+    std::vector<unsigned> candidates;
+    for (auto pos = 0U; pos < size * size; pos++) {
+        if (deleted[pos] == 0) {
+            continue;
+        }
+        candidates.clear();
+        const auto row = pos / size;
+        const auto column = pos % size;
+        for (auto i = 0U; i < size; i++) {
+            if (deleted[row * size + i] == 0) {
+                candidates.push_back(table.values[row * size + i]);
+            }
+            if (deleted[i * size + column] == 0) {
+                candidates.push_back(table.values[i * size + column]);
+            }
+        }
+        table.values[pos] = candidates[std::uniform_int_distribution<size_t>(0, candidates.size() - 1)(random)];
+    }
+
+    if (shading != nullptr) {
+        *shading = std::move(deleted);
+    }
+    return table;
+}
+
+struct Puzzle {
+    std::string id;
+    TableValues values;
+    std::string error;
+};
+
+// Reads every table of the stream, a malformed one becomes a Puzzle with
+// an error message. The tables of a stream holding more than one are told
+// apart by their 1-based index appended to the name.
+inline void readPuzzles(std::istream &in, const std::string &name, std::vector<Puzzle> &puzzles) {
+    const auto first = puzzles.size();
+    TableReader reader(in);
+    while (true) {
+        Puzzle puzzle;
+        try {
+            if (!reader.read(puzzle.values)) {
+                break;
+            }
+        } catch (const std::exception &e) {
+            puzzle.error = e.what();
+        }
+        puzzles.push_back(std::move(puzzle));
+    }
+
+    const auto count = puzzles.size() - first;
+    for (auto i = first; i < puzzles.size(); i++) {
+        puzzles[i].id = count > 1 ? name + ":" + std::to_string(i - first + 1) : name;
+    }
+}
+
+// Solves the puzzles nextPuzzle reads, until it returns false, on jobCount
+// threads and calls onResult with each puzzle and its result in input
+// order, on the calling thread. A few puzzles per job are read ahead of the
+// oldest one not reported yet, no more, so a batch of any size is solved in
+// bounded memory. Returns false if any of the puzzles couldn't be solved.
+template <typename NextPuzzle, typename OnResult>
+bool solvePuzzles(NextPuzzle &&nextPuzzle, SolveOptions options, unsigned jobCount, OnResult &&onResult) {
+    options.threadCount = 1;
+
+    struct Slot {
+        Puzzle puzzle;
+        SolveResult result;
+        bool finished = false;
+    };
+
+    // The puzzles read and not reported yet, oldest first. Only the calling
+    // thread adds and removes slots, at the ends, which leaves the others in
+    // place for the jobs.
+    std::deque<Slot> slots;
+    const auto windowSize = std::max(jobCount, 1U) * size_t(4);
+    std::mutex mutex;
+    std::condition_variable resultFinished;
+
+    ThreadPool pool(jobCount);
+    auto allSolved = true;
+    auto moreToRead = true;
+    while (true) {
+        while (moreToRead && slots.size() < windowSize) {
+            Slot added;
+            moreToRead = nextPuzzle(added.puzzle);
+            if (!moreToRead) {
+                break;
+            }
+
+            slots.push_back(std::move(added));
+            const auto slot = &slots.back();
+            pool.submit([&, slot]() {
+                SolveResult result;
+                try {
+                    if (slot->puzzle.error.empty()) {
+                        result = solveTable(slot->puzzle.values, options);
+                    } else {
+                        result.error = slot->puzzle.error;
+                    }
+                } catch (const std::exception &e) {
+                    result.error = e.what();
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+                slot->result = std::move(result);
+                slot->finished = true;
+                resultFinished.notify_all();
+            });
+        }
+        if (slots.empty()) {
+            break;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        auto &oldest = slots.front();
+        resultFinished.wait(lock, [&]() {
+            return oldest.finished;
+        });
+        const auto result = std::move(oldest.result);
+        lock.unlock();
+
+        onResult(oldest.puzzle, result);
+        allSolved = allSolved && result.success;
+        slots.pop_front();
+    }
+
+    return allSolved;
+}
+
+// Solves the puzzles like solvePuzzles, from a list.
+template <typename OnResult>
+bool solveBatch(const std::vector<Puzzle> &puzzles, SolveOptions options, unsigned jobCount, OnResult &&onResult) {
+    size_t next = 0;
+    return solvePuzzles([&](Puzzle &puzzle) {
+        if (next == puzzles.size()) {
+            return false;
+        }
+        puzzle = puzzles[next++];
+        return true;
+    }, options, jobCount, std::forward<OnResult>(onResult));
+}
+
+struct GeneratorOptions {
+    unsigned size = 10;
+    // The range of branch points the search takes to prove a puzzle unique,
+    // a measure of the guessing it needs. A maximum of 0 means no limit.
+    unsigned long long minBranchPoints = 0;
+    unsigned long long maxBranchPoints = 0;
+    // Candidate boards tried for a puzzle before giving up on it, and value
+    // changes tried on a candidate before dropping it.
+    unsigned maxCandidates = 1000;
+    unsigned maxRepairs = 64;
+    uint64_t seed = 0;
+};
+
+struct GeneratedPuzzle {
+    Puzzle puzzle;
+    // The solution, with the stats of the search that proved it unique.
+    SolveResult result;
+    unsigned candidates = 0;
+    unsigned repairs = 0;
+};
+
+// Generates puzzles with a unique solution. A candidate is a board of
+// generateTable, whose shading is a solution of it. Every probe searches
+// the board for another solution; while there is one, a cell the shading
+// deletes but the other solution keeps gets the value of a cell of its
+// lines the other solution keeps. That rules the other solution out while
+// the shading stays one. The probes reuse the table of the thread. The
+// puzzle of an index only depends on the options and the index, not on the
+// thread that generated it.
+class PuzzleGenerator {
+private:
+    GeneratorOptions options;
+
+public:
+    PuzzleGenerator(const GeneratorOptions &options):
+        options(options) { }
+
+    GeneratedPuzzle generate(unsigned long long index) const {
+        GeneratedPuzzle generated;
+        generated.puzzle.id = "generated:" + std::to_string(index + 1);
+
+        std::seed_seq sequence{
+            static_cast<uint32_t>(options.seed), static_cast<uint32_t>(options.seed >> 32),
+            static_cast<uint32_t>(index), static_cast<uint32_t>(index >> 32)
+        };
+        std::mt19937_64 random(sequence);
+
+        visitTableType(options.size, [&](auto tableType) {
+            using TableType = typename decltype(tableType)::type;
+            auto &t = ThreadWorkspace<TableType>::get().table;
+            std::vector<char> shading;
+            while (generated.candidates < options.maxCandidates) {
+                generated.candidates++;
+                auto values = generateTable(options.size, random, &shading);
+                SearchStats stats;
+                if (!makeUnique(t, values, shading, random, generated, stats) || !isWithinTarget(stats.branchPoints)) {
+                    continue;
+                }
+
+                generated.puzzle.values = std::move(values);
+                auto &result = generated.result;
+                result.success = true;
+                result.solutionCount = 1;
+                result.exhaustive = true;
+                result.stats = stats;
+                std::vector<uint8_t> deleted(shading.begin(), shading.end());
+                CorpusFormat::pack(result.solutionMask, deleted.data(), deleted.size(), 1);
+                return;
+            }
+
+            generated.puzzle.error = "no puzzle found in " + std::to_string(options.maxCandidates) + " candidates";
+            generated.result.error = generated.puzzle.error;
+        });
+        return generated;
+    }
+
+private:
+    bool isWithinTarget(unsigned long long branchPoints) const {
+        return branchPoints >= options.minBranchPoints &&
+            (options.maxBranchPoints == 0 || branchPoints <= options.maxBranchPoints);
+    }
+
+    // Repairs values until shading is the only solution, stats are those of
+    // the last probe then. Returns false if the candidate is dropped.
+    template <typename TableType>
+    bool makeUnique(TableType &t, TableValues &values, const std::vector<char> &shading, std::mt19937_64 &random,
+                    GeneratedPuzzle &generated, SearchStats &stats) const {
+        const auto size = values.size;
+        std::vector<char> other(size * size);
+        std::vector<unsigned> choices;
+        for (auto repair = 0U; repair <= options.maxRepairs; repair++) {
+            t.reset(values);
+            stats = SearchStats();
+            const auto found = t.applyPatterns() == TableBase::Conflict::None && search(t, [&](const TableType &solution) {
+                auto differs = false;
+                for (auto pos = 0U; pos < size * size; pos++) {
+                    other[pos] = solution.getCell(pos / size, pos % size).getState() == TableBase::Cell::State::Deleted;
+                    differs = differs || other[pos] != shading[pos];
+                }
+                return differs;
+            }, stats);
+            if (!found) {
+                return true;
+            }
+            if (repair == options.maxRepairs) {
+                break;
+            }
+            generated.repairs++;
+
+            // Without such a cell the other solution deletes a superset of
+            // the shading, and changing values can't rule it out.
+            choices.clear();
+            for (auto pos = 0U; pos < size * size; pos++) {
+                if (shading[pos] != 0 && other[pos] == 0) {
+                    choices.push_back(pos);
+                }
+            }
+            if (choices.empty()) {
+                return false;
+            }
+            const auto pos = choices[std::uniform_int_distribution<size_t>(0, choices.size() - 1)(random)];
+
+            // A kept cell always has a kept neighbor, so there is a choice.
+            const auto row = pos / size;
+            const auto column = pos % size;
+            choices.clear();
+            for (auto i = 0U; i < size; i++) {
+                if (i != column && other[row * size + i] == 0) {
+                    choices.push_back(row * size + i);
+                }
+                if (i != row && other[i * size + column] == 0) {
+                    choices.push_back(i * size + column);
+                }
+            }
+            if (choices.empty()) {
+                return false;
+            }
+            values.values[pos] = values.values[choices[std::uniform_int_distribution<size_t>(0, choices.size() - 1)(random)]];
+        }
+        return false;
+    }
+};
+
+// Generates count puzzles on jobCount threads and calls onPuzzle with each,
+// in index order. Like solvePuzzles, only a few puzzles per job are queued
+// ahead of the oldest one not reported yet. Returns whether every puzzle was
+// found.
+template <typename OnPuzzle>
+bool generatePuzzles(const GeneratorOptions &options, unsigned long long count, unsigned jobCount, OnPuzzle &&onPuzzle) {
+    const PuzzleGenerator generator(options);
+
+    struct Slot {
+        GeneratedPuzzle generated;
+        bool finished = false;
+    };
+
+    // The puzzles queued and not reported yet, oldest first, see
+    // solvePuzzles.
+    std::deque<Slot> slots;
+    const auto windowSize = std::max(jobCount, 1U) * size_t(4);
+    std::mutex mutex;
+    std::condition_variable puzzleFinished;
+
+    ThreadPool pool(jobCount);
+    auto allFound = true;
+    auto next = 0ULL;
+    while (true) {
+        for (; next < count && slots.size() < windowSize; next++) {
+            slots.emplace_back();
+            pool.submit([&, slot = &slots.back(), i = next]() {
+                GeneratedPuzzle generated;
+                try {
+                    generated = generator.generate(i);
+                } catch (const std::exception &e) {
+                    generated.puzzle.id = "generated:" + std::to_string(i + 1);
+                    generated.puzzle.error = e.what();
+                    generated.result.error = e.what();
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+                slot->generated = std::move(generated);
+                slot->finished = true;
+                puzzleFinished.notify_all();
+            });
+        }
+        if (slots.empty()) {
+            break;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        auto &oldest = slots.front();
+        puzzleFinished.wait(lock, [&]() {
+            return oldest.finished;
+        });
+        const auto generated = std::move(oldest.generated);
+        lock.unlock();
+
+        onPuzzle(generated);
+        allFound = allFound && generated.result.success;
+        slots.pop_front();
+    }
+
+    return allFound;
+}
@@ -0,0 +1,725 @@
+#pragma once
+
+#include "HitoriServer.h"
+
+#include <deque>
+#include <filesystem>
+#include <fstream>
+
+#ifndef _WIN32
+#include <sys/time.h>
+
+// Solves a binary corpus on worker processes spread over many machines. A
+// coordinator splits the corpus into shards of consecutive records and
+// hands them out over TCP to the workers that connect to it, one shard at a
+// time per worker. Every line of the protocol ends with '\n'.
+//
+// The coordinator sends a shard as a header line and one line per table,
+// the tables in the request format of the server without options:
+//
+//   shard SHARD COUNT first|unique|count NODE_LIMIT TIME_LIMIT_MS
+//         search|sat|auto LEARN KEEP_ALIVE_MS
+//   INDEX ROW/ROW/...
+//
+// (the header on one line) or "done" when every shard is solved. LEARN is 1
+// if the search learns nogoods. The worker answers every table, in the
+// order of the shard, with one of:
+//
+//   INDEX FLAGS SOLUTIONS NODES BRANCH_POINTS MASK
+//   INDEX error MESSAGE
+//
+// FLAGS holds the CorpusFormat flags of the record, MASK the solution mask
+// in hex, or - if there is no solution. In between, the worker sends
+// "alive" every KEEP_ALIVE_MS while it solves, unless that is 0. A worker
+// that closes the connection, sends a malformed line or stays silent for
+// longer than the lease loses its shard, which goes back to the queue for
+// the next worker. A shard lost by more workers than the retry limit is
+// given up: its tables are answered with errors.
+//
+// Each solved shard is saved to a file of its own in the checkpoint
+// directory, in the same lines as the answers. A coordinator started again
+// on the same corpus, with the same settings, and checkpoint only hands out
+// the missing shards.
+// Once every shard is solved, the shards are merged into one corpus with
+// the results and their node and branch point counts. The tables answered
+// with errors get the Failed flag, which tells them from unsearched ones.
+
+// The answer line to a table of a shard.
+inline void appendShardResult(std::string &out, unsigned long long index, const SolveResult &result) {
+    out += std::to_string(index);
+    if (!result.error.empty()) {
+        out += " error ";
+        for (const auto c : result.error) {
+            out += c == '\n' || c == '\r' ? ' ' : c;
+        }
+        out += '\n';
+        return;
+    }
+
+    auto flags = CorpusFormat::Searched;
+    if (result.exhaustive) {
+        flags |= CorpusFormat::Exhaustive;
+    }
+    if (result.timedOut) {
+        flags |= CorpusFormat::TimedOut;
+    }
+    out += ' ';
+    out += std::to_string(flags);
+    out += ' ';
+    out += std::to_string(result.solutionCount);
+    out += ' ';
+    out += std::to_string(result.stats.nodes);
+    out += ' ';
+    out += std::to_string(result.stats.branchPoints);
+    out += ' ';
+    if (result.solutionMask.empty()) {
+        out += '-';
+    }
+    for (const auto byte : result.solutionMask) {
+        out += "0123456789abcdef"[byte >> 4];
+        out += "0123456789abcdef"[byte & 15];
+    }
+    out += '\n';
+}
+
+// Reads an answer line into index and result. Returns false if the line is
+// malformed.
+inline bool parseShardResult(const std::string &line, unsigned long long &index, SolveResult &result) {
+    const auto end = line.data() + line.size();
+    auto p = line.data();
+    const auto parseNumber = [&](unsigned long long &value) {
+        const auto parsed = std::from_chars(p, end, value);
+        if (parsed.ec != std::errc() || parsed.ptr == end || *parsed.ptr != ' ') {
+            return false;
+        }
+        p = parsed.ptr + 1;
+        return true;
+    };
+
+    result = SolveResult();
+    if (!parseNumber(index)) {
+        return false;
+    }
+    if (line.compare(static_cast<size_t>(p - line.data()), 6, "error ") == 0) {
+        result.error.assign(p + 6, end);
+        return !result.error.empty();
+    }
+
+    auto flags = 0ULL;
+    if (!parseNumber(flags) || (flags & CorpusFormat::Searched) == 0 || !parseNumber(result.solutionCount) ||
+        !parseNumber(result.stats.nodes) || !parseNumber(result.stats.branchPoints)) {
+        return false;
+    }
+    result.exhaustive = (flags & CorpusFormat::Exhaustive) != 0;
+    result.timedOut = (flags & CorpusFormat::TimedOut) != 0;
+
+    if (end - p == 1 && *p == '-') {
+        return result.solutionCount == 0;
+    }
+    const auto getDigit = [](char c) {
+        return c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+    };
+    for (; end - p >= 2; p += 2) {
+        const auto high = getDigit(p[0]);
+        const auto low = getDigit(p[1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        result.solutionMask.push_back(static_cast<uint8_t>(high << 4 | low));
+    }
+    return p == end && result.solutionCount != 0;
+}
+
+// Whether a result means success in the given mode, as solveTable has it.
+inline bool isSolved(const SolveResult &result, SolveMode mode) {
+    return result.error.empty() && result.solutionCount != 0 && !result.timedOut &&
+        !(mode == SolveMode::Unique && result.solutionCount > 1);
+}
+
+// Reads the lines of a socket through a buffer.
+class SocketLineReader {
+public:
+    // The longest line, a table of the largest size in the request format
+    // fits with room to spare.
+    static constexpr size_t MaxLineSize = SolveServer::MaxRequestSize;
+
+private:
+    int socket;
+    std::vector<char> buffer;
+    size_t begin, end;
+
+public:
+    explicit SocketLineReader(int socket):
+        socket(socket),
+        buffer(1 << 16),
+        begin(0),
+        end(0) { }
+
+    // Reads the next line without its '\n'. Returns false at the end of the
+    // stream, on errors, on timeouts and on lines longer than MaxLineSize.
+    bool readLine(std::string &line) {
+        while (true) {
+            const auto first = buffer.data() + begin;
+            const auto last = buffer.data() + end;
+            const auto newline = std::find(first, last, '\n');
+            if (newline != last) {
+                line.assign(first, newline);
+                begin = static_cast<size_t>(newline - buffer.data()) + 1;
+                return true;
+            }
+
+            std::memmove(buffer.data(), first, end - begin);
+            end -= begin;
+            begin = 0;
+            if (end == buffer.size()) {
+                if (buffer.size() >= MaxLineSize) {
+                    return false;
+                }
+                buffer.resize(std::min(2 * buffer.size(), MaxLineSize));
+            }
+            const auto count = recv(socket, buffer.data() + end, buffer.size() - end, 0);
+            if (count <= 0) {
+                return false;
+            }
+            end += static_cast<size_t>(count);
+        }
+    }
+};
+
+inline bool sendAll(int socket, const std::string &data) {
+    size_t sent = 0;
+    while (sent != data.size()) {
+        const auto count = send(socket, data.data() + sent, data.size() - sent, 0);
+        if (count <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(count);
+    }
+    return true;
+}
+
+// Connects to HOST:PORT. Returns the socket, or -1 if it can't connect.
+inline int connectTcp(const std::string &hostPort) {
+    const auto colon = hostPort.rfind(':');
+    if (colon == std::string::npos) {
+        return -1;
+    }
+    const auto host = hostPort.substr(0, colon);
+    const auto port = hostPort.substr(colon + 1);
+
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *addresses = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0) {
+        return -1;
+    }
+    auto connection = -1;
+    for (auto a = addresses; a != nullptr && connection < 0; a = a->ai_next) {
+        connection = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (connection >= 0 && connect(connection, a->ai_addr, a->ai_addrlen) != 0) {
+            close(connection);
+            connection = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    return connection;
+}
+
+// Hands the shards of a corpus out to the workers that connect, see the
+// protocol above, and merges their results.
+class ShardCoordinator {
+public:
+    struct Stats {
+        unsigned long long shards = 0;
+        // Shards solved by an earlier run, found in the checkpoint.
+        unsigned long long resumedShards = 0;
+        // Shards handed out again after their worker was lost.
+        unsigned long long retries = 0;
+        // Shards given up after too many lost workers.
+        unsigned long long failedShards = 0;
+        unsigned long long workers = 0;
+    };
+
+private:
+    CorpusReader &reader;
+    SolveOptions options;
+    size_t shardSize;
+    std::filesystem::path checkpointDirectory;
+    std::chrono::milliseconds lease;
+    unsigned retryLimit;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<size_t> queue;
+    std::vector<char> solved;
+    // The workers each shard was lost by.
+    std::vector<unsigned> lostCounts;
+    size_t solvedCount;
+    // Set when a shard can't be saved, it stops the run.
+    std::string failure;
+    bool stopping;
+    std::vector<int> clients;
+    std::vector<std::thread> threads;
+    // The threads of the workers that are gone, joined by the acceptor.
+    std::vector<std::thread::id> finishedThreads;
+    Stats stats;
+
+public:
+    // Solves the tables of reader with the mode, the limits, the backend and
+    // the learning of options, shardSize tables to a shard. A lease of 0
+    // lets workers stay silent for any time. A shard is handed out again at
+    // most retryLimit times. Throws std::runtime_error if the checkpoint
+    // directory can't be used or belongs to another run.
+    ShardCoordinator(CorpusReader &reader, const SolveOptions &options, size_t shardSize,
+                     const std::string &checkpointDirectory, std::chrono::milliseconds lease, unsigned retryLimit):
+        reader(reader),
+        options(options),
+        shardSize(std::max<size_t>(shardSize, 1)),
+        checkpointDirectory(checkpointDirectory),
+        lease(lease),
+        retryLimit(retryLimit),
+        solvedCount(0),
+        stopping(false) {
+
+        const auto recordCount = reader.getRecordCount();
+        const auto shardCount = (recordCount + this->shardSize - 1) / this->shardSize;
+        stats.shards = shardCount;
+
+        std::error_code error;
+        std::filesystem::create_directories(this->checkpointDirectory, error);
+        if (error) {
+            throw std::runtime_error("unable to create the checkpoint directory " + checkpointDirectory);
+        }
+
+        // The run a checkpoint belongs to, its shards don't fit any other.
+        char fingerprint[17];
+        std::snprintf(fingerprint, sizeof(fingerprint), "%016llx",
+                      static_cast<unsigned long long>(reader.getFingerprint()));
+        std::string run = "corpus " + std::string(fingerprint) + " records " + std::to_string(recordCount) +
+            " shard-size " + std::to_string(this->shardSize) + " mode " + getModeName(options.mode) +
+            " nodes " + std::to_string(options.nodeLimit) + " time-limit " + std::to_string(options.timeLimit.count()) +
+            " backend " + getBackendName(options.backend) + " learn " + (options.learnNogoods ? "1" : "0") + '\n';
+        const auto runFile = this->checkpointDirectory / "run.txt";
+        std::ifstream in(runFile, std::ios::binary);
+        if (in.good()) {
+            const std::string savedRun((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            if (savedRun != run) {
+                throw std::runtime_error("the checkpoint " + checkpointDirectory + " belongs to another run");
+            }
+        } else if (!writeFile(runFile, run)) {
+            throw std::runtime_error("unable to write the checkpoint " + runFile.string());
+        }
+
+        solved.assign(shardCount, 0);
+        lostCounts.assign(shardCount, 0);
+        for (size_t shard = 0; shard < shardCount; shard++) {
+            if (std::filesystem::is_regular_file(getShardFile(shard), error)) {
+                solved[shard] = 1;
+                solvedCount++;
+                stats.resumedShards++;
+            } else {
+                queue.push_back(shard);
+            }
+        }
+    }
+
+    Stats getStats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+
+    // Listens on tcp:[HOST:]PORT and serves the workers until every shard is
+    // solved. Returns an error message if that failed.
+    std::string run(const std::string &address) {
+        if (address.compare(0, 4, "tcp:") != 0) {
+            return "invalid address " + address + ", expected tcp:[HOST:]PORT";
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (solvedCount == solved.size()) {
+                return std::string();
+            }
+        }
+
+        // A worker that goes away fails its writes instead of killing us.
+        signal(SIGPIPE, SIG_IGN);
+        const auto listener = openTcpListener(address.substr(4));
+        if (listener < 0) {
+            return "unable to bind " + address.substr(4);
+        }
+        if (listen(listener, SOMAXCONN) != 0) {
+            close(listener);
+            return "unable to listen on " + address;
+        }
+
+        std::thread acceptor([this, listener]() {
+            while (true) {
+                const auto client = accept(listener, nullptr, nullptr);
+                std::unique_lock<std::mutex> lock(mutex);
+                auto finished = takeFinishedThreads();
+                const auto stopped = stopping;
+                if (!stopped && client >= 0) {
+                    stats.workers++;
+                    clients.push_back(client);
+                    threads.emplace_back([this, client]() {
+                        serveWorker(client);
+                    });
+                }
+                lock.unlock();
+
+                for (auto &thread : finished) {
+                    thread.join();
+                }
+                if (stopped) {
+                    if (client >= 0) {
+                        close(client);
+                    }
+                    return;
+                }
+            }
+        });
+
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this]() {
+            return solvedCount == solved.size() || !failure.empty();
+        });
+        // Wakes up the acceptor, and the workers still holding a shard if
+        // the run failed. The others are told that it is done.
+        stopping = true;
+        shutdown(listener, SHUT_RDWR);
+        if (!failure.empty()) {
+            for (const auto client : clients) {
+                shutdown(client, SHUT_RDWR);
+            }
+        }
+        changed.notify_all();
+        lock.unlock();
+
+        acceptor.join();
+        close(listener);
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        threads.clear();
+        finishedThreads.clear();
+        return failure;
+    }
+
+    // Writes the corpus with the results of every shard to out, calling
+    // onResult with the index of every table and its result. Throws
+    // std::runtime_error if a shard is missing or corrupt.
+    template <typename OnResult>
+    void merge(std::ostream &out, OnResult &&onResult) {
+        CorpusWriter writer(out, true);
+        TableValues values;
+        SolveResult result;
+        std::string line;
+        for (size_t shard = 0; shard < solved.size(); shard++) {
+            const auto shardFile = getShardFile(shard);
+            std::ifstream in(shardFile, std::ios::binary);
+            const auto first = shard * shardSize;
+            const auto last = std::min(first + shardSize, reader.getRecordCount());
+            for (auto index = first; index < last; index++) {
+                auto lineIndex = 0ULL;
+                if (!std::getline(in, line) || !parseShardResult(line, lineIndex, result) || lineIndex != index) {
+                    throw std::runtime_error("the checkpoint " + shardFile.string() + " is corrupt");
+                }
+                reader.read(index, values);
+                writer.write(values, &result);
+                onResult(index, result);
+            }
+        }
+        writer.finish();
+    }
+
+private:
+    static const char *getModeName(SolveMode mode) {
+        switch (mode) {
+        case SolveMode::First:
+            return "first";
+
+        case SolveMode::Count:
+            return "count";
+
+        case SolveMode::Unique:
+            return "unique";
+        }
+        return "first";
+    }
+
+    static const char *getBackendName(SolverBackendKind backend) {
+        switch (backend) {
+        case SolverBackendKind::Search:
+            return "search";
+
+        case SolverBackendKind::Sat:
+            return "sat";
+
+        case SolverBackendKind::Auto:
+            return "auto";
+        }
+        return "search";
+    }
+
+    // Writes a temporary file first, so an interrupted run leaves no
+    // partial file behind.
+    static bool writeFile(const std::filesystem::path &file, const std::string &text) {
+        auto temporaryFile = file;
+        temporaryFile += ".tmp";
+        {
+            std::ofstream out(temporaryFile, std::ios::binary | std::ios::trunc);
+            out.write(text.data(), static_cast<std::streamsize>(text.size()));
+            out.flush();
+            if (!out.good()) {
+                return false;
+            }
+        }
+        std::error_code error;
+        std::filesystem::rename(temporaryFile, file, error);
+        return !error;
+    }
+
+    std::filesystem::path getShardFile(size_t shard) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "shard-%08zu.txt", shard);
+        return checkpointDirectory / name;
+    }
+
+    // Saves an error for every table of a shard lost too often, and counts
+    // it as solved. Called under the lock.
+    void giveUp(size_t shard, size_t first, size_t last) {
+        std::string answers;
+        for (auto index = first; index < last; index++) {
+            SolveResult result;
+            result.error = "the shard was lost by " + std::to_string(lostCounts[shard]) + " workers";
+            appendShardResult(answers, index, result);
+        }
+        if (!writeFile(getShardFile(shard), answers)) {
+            failure = "unable to write the checkpoint " + getShardFile(shard).string();
+            return;
+        }
+        solved[shard] = 1;
+        solvedCount++;
+        stats.failedShards++;
+    }
+
+    // Hands shards to the worker on client until there are none left, or
+    // the worker is lost.
+    void serveWorker(int client) {
+        const auto keepAlive = 1;
+        setsockopt(client, SOL_SOCKET, SO_KEEPALIVE, &keepAlive, sizeof(keepAlive));
+        timeval timeout = {};
+        timeout.tv_sec = static_cast<time_t>(lease.count() / 1000);
+        timeout.tv_usec = static_cast<suseconds_t>(lease.count() % 1000 * 1000);
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        SocketLineReader in(client);
+        std::string request, answers, line;
+        std::vector<size_t> maskSizes;
+        while (true) {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this]() {
+                return !queue.empty() || stopping;
+            });
+            if (stopping) {
+                if (failure.empty()) {
+                    lock.unlock();
+                    sendAll(client, "done\n");
+                }
+                break;
+            }
+            const auto shard = queue.front();
+            queue.pop_front();
+
+            // The reader isn't shared, so the shard is read under the lock.
+            const auto first = shard * shardSize;
+            const auto last = std::min(first + shardSize, reader.getRecordCount());
+            // Keep-alives at a quarter of the lease leave room for delays.
+            request = "shard " + std::to_string(shard) + ' ' + std::to_string(last - first) + ' ' +
+                getModeName(options.mode) + ' ' + std::to_string(options.nodeLimit) + ' ' +
+                std::to_string(options.timeLimit.count()) + ' ' + getBackendName(options.backend) + ' ' +
+                (options.learnNogoods ? '1' : '0') + ' ' + std::to_string((lease.count() + 3) / 4) + '\n';
+            maskSizes.clear();
+            TableValues values;
+            std::vector<uint8_t> deleted;
+            for (auto index = first; index < last; index++) {
+                reader.read(index, values);
+                maskSizes.push_back(CorpusFormat::getPackedSize(values.values.size(), 1));
+                deleted.assign(values.values.size(), 0);
+                request += std::to_string(index);
+                request += ' ';
+                TableFormatter::append(request, values, deleted, TableFormatter::Style::Compact);
+            }
+            lock.unlock();
+
+            answers.clear();
+            auto answered = sendAll(client, request);
+            for (auto index = first; answered && index < last; index++) {
+                auto lineIndex = 0ULL;
+                SolveResult result;
+                do {
+                    answered = in.readLine(line);
+                } while (answered && line == "alive");
+                answered = answered && parseShardResult(line, lineIndex, result) && lineIndex == index &&
+                    (result.solutionCount == 0 || result.solutionMask.size() == maskSizes[index - first]);
+                answers += line;
+                answers += '\n';
+            }
+            const auto saved = answered && writeFile(getShardFile(shard), answers);
+
+            lock.lock();
+            if (!answered && ++lostCounts[shard] <= retryLimit) {
+                queue.push_front(shard);
+                stats.retries++;
+                changed.notify_all();
+                break;
+            }
+            if (!answered) {
+                giveUp(shard, first, last);
+                changed.notify_all();
+                break;
+            }
+            if (!saved) {
+                failure = "unable to write the checkpoint " + getShardFile(shard).string();
+            } else {
+                solved[shard] = 1;
+                solvedCount++;
+            }
+            changed.notify_all();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        clients.erase(std::find(clients.begin(), clients.end(), client));
+        close(client);
+        finishedThreads.push_back(std::this_thread::get_id());
+    }
+
+    // Takes the threads of the workers that are gone out of threads, to be
+    // joined without the lock. Called with the lock held.
+    std::vector<std::thread> takeFinishedThreads() {
+        std::vector<std::thread> finished;
+        for (auto thread = threads.begin(); thread != threads.end();) {
+            if (std::find(finishedThreads.begin(), finishedThreads.end(), thread->get_id()) != finishedThreads.end()) {
+                finished.push_back(std::move(*thread));
+                thread = threads.erase(thread);
+            } else {
+                ++thread;
+            }
+        }
+        finishedThreads.clear();
+        return finished;
+    }
+};
+
+// Connects to the coordinator at tcp:HOST:PORT and solves the shards it
+// hands out, jobCount tables at a time, until it has none left. The mode,
+// the limits, the backend and the learning come from the coordinator, the
+// rest from options. Returns
+// an error message if the connection failed before the end.
+inline std::string workShards(const std::string &address, SolveOptions options, unsigned jobCount, SearchStats &totalStats) {
+    if (address.compare(0, 4, "tcp:") != 0) {
+        return "invalid address " + address + ", expected tcp:HOST:PORT";
+    }
+    signal(SIGPIPE, SIG_IGN);
+    const auto connection = connectTcp(address.substr(4));
+    if (connection < 0) {
+        return "unable to connect to " + address.substr(4);
+    }
+    const auto keepAlive = 1;
+    setsockopt(connection, SOL_SOCKET, SO_KEEPALIVE, &keepAlive, sizeof(keepAlive));
+
+    // Losing the coordinator stops the rest of the shard.
+    CancellationToken lost;
+    options.format = OutputFormat::Binary;
+    options.cancellationToken = &lost;
+    SocketLineReader in(connection);
+    std::string line, answer;
+    std::vector<Puzzle> puzzles;
+    std::string error = "lost the connection to " + address.substr(4);
+    while (in.readLine(line)) {
+        if (line == "done") {
+            error.clear();
+            break;
+        }
+
+        char mode[16] = {}, backend[16] = {};
+        auto shard = 0ULL, count = 0ULL, nodeLimit = 0ULL, timeLimit = 0ULL, keepAlive = 0ULL;
+        auto learn = 0U;
+        if (std::sscanf(line.c_str(), "shard %llu %llu %15s %llu %llu %15s %u %llu", &shard, &count, mode,
+                        &nodeLimit, &timeLimit, backend, &learn, &keepAlive) != 8) {
+            error = "invalid shard header " + line;
+            break;
+        }
+        options.mode = std::strcmp(mode, "count") == 0 ? SolveMode::Count :
+            std::strcmp(mode, "unique") == 0 ? SolveMode::Unique : SolveMode::First;
+        options.nodeLimit = nodeLimit;
+        options.timeLimit = std::chrono::milliseconds(timeLimit);
+        options.backend = std::strcmp(backend, "sat") == 0 ? SolverBackendKind::Sat :
+            std::strcmp(backend, "auto") == 0 ? SolverBackendKind::Auto : SolverBackendKind::Search;
+        options.learnNogoods = learn != 0;
+
+        // A malformed table is answered with its error.
+        puzzles.assign(static_cast<size_t>(count), Puzzle());
+        auto complete = true;
+        for (auto &puzzle : puzzles) {
+            if (!in.readLine(line)) {
+                complete = false;
+                break;
+            }
+            ServerRequest request;
+            try {
+                parseServerRequest(line.data(), line.data() + line.size(), request);
+                puzzle.values = std::move(request.values);
+            } catch (const std::invalid_argument &e) {
+                puzzle.error = e.what();
+            }
+            puzzle.id = request.id;
+        }
+        if (!complete) {
+            break;
+        }
+
+        // The answers and the keep-alives share the connection.
+        std::mutex sendMutex;
+        std::condition_variable solvedShard;
+        auto sent = true, finished = false;
+        std::thread keepAliveThread;
+        if (keepAlive != 0) {
+            keepAliveThread = std::thread([&]() {
+                std::unique_lock<std::mutex> lock(sendMutex);
+                while (!solvedShard.wait_for(lock, std::chrono::milliseconds(keepAlive), [&]() { return finished; })) {
+                    sent = sent && sendAll(connection, "alive\n");
+                    if (!sent) {
+                        lost.cancel();
+                    }
+                }
+            });
+        }
+        solveBatch(puzzles, options, jobCount, [&](const Puzzle &puzzle, const SolveResult &result) {
+            answer.clear();
+            appendShardResult(answer, std::strtoull(puzzle.id.c_str(), nullptr, 10), result);
+            std::lock_guard<std::mutex> lock(sendMutex);
+            sent = sent && sendAll(connection, answer);
+            if (!sent) {
+                lost.cancel();
+            }
+            totalStats.merge(result.stats);
+        });
+        {
+            std::lock_guard<std::mutex> lock(sendMutex);
+            finished = true;
+        }
+        solvedShard.notify_all();
+        if (keepAliveThread.joinable()) {
+            keepAliveThread.join();
+        }
+        if (!sent) {
+            break;
+        }
+    }
+
+    close(connection);
+    return error;
+}
+#endif
@@ -0,0 +1,589 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+// A small incremental CDCL SAT solver, the engine of the SAT backend of the
+// Hitori solver. It uses:
+// - two watched literals per clause
+// - first UIP learning with clause minimization
+// - variable activities with phase saving
+// - Luby restarts
+// - a learned clause store halved by activity
+//
+// Clauses can be added between calls of solve(). Everything learned is
+// kept, which is what makes adding the connectivity cuts one by one cheap.
+class SatSolver {
+public:
+    // Variable v is true as the literal 2 * v and false as 2 * v + 1.
+    using Literal = unsigned;
+
+    enum class Result {
+        Satisfiable,
+        Unsatisfiable,
+        // solve() was stopped.
+        Unknown
+    };
+
+    enum Value : uint8_t {
+        False = 0,
+        True = 1,
+        Unassigned = 2
+    };
+
+    static Literal makeLiteral(unsigned variable, bool value) {
+        return variable * 2 + (value ? 0 : 1);
+    }
+
+    static Literal negate(Literal literal) {
+        return literal ^ 1;
+    }
+
+    static unsigned getVariable(Literal literal) {
+        return literal / 2;
+    }
+
+private:
+    static constexpr unsigned NoClause = ~0U;
+    static constexpr unsigned NoVariable = ~0U;
+    static constexpr unsigned RestartBase = 100;
+    static constexpr unsigned MinLearnedLimit = 2000;
+    static constexpr double VariableDecay = 0.95;
+    static constexpr double ClauseDecay = 0.999;
+
+    // The literals of a clause are literals[start, start + size). The two
+    // first are watched; a clause implying a literal has it first.
+    struct Clause {
+        unsigned start;
+        unsigned size;
+        bool learned;
+        double activity;
+    };
+
+    // A clause watching a literal, with another literal of it whose truth
+    // makes visiting the clause needless.
+    struct Watch {
+        unsigned clause;
+        Literal blocker;
+    };
+
+    std::vector<Clause> clauses;
+    std::vector<Literal> literals;
+    std::vector<std::vector<Watch>> watches;
+    unsigned learnedCount;
+    double learnedLimit;
+    bool unsatisfiable;
+
+    std::vector<uint8_t> values;
+    std::vector<uint8_t> savedPhases;
+    std::vector<unsigned> levels;
+    std::vector<unsigned> reasons;
+    std::vector<Literal> trail;
+    // The trail size at the start of every decision level.
+    std::vector<size_t> trailLimits;
+    size_t propagationHead;
+
+    // A binary max heap of the unassigned variables by activity.
+    std::vector<double> activities;
+    double variableIncrement;
+    double clauseIncrement;
+    std::vector<unsigned> heap;
+    std::vector<unsigned> heapPositions;
+
+    unsigned long long decisionCount;
+    unsigned long long conflictCount;
+    unsigned restartCount;
+
+    // Scratch of analyze().
+    std::vector<uint8_t> seen;
+    std::vector<Literal> learned;
+    std::vector<Literal> analyzed;
+
+public:
+    SatSolver() {
+        reset(0);
+    }
+
+    // Makes the solver empty with variables 0 to variableCount - 1, keeping
+    // the storage.
+    void reset(unsigned variableCount) {
+        clauses.clear();
+        literals.clear();
+        watches.resize(2 * variableCount);
+        for (auto &list : watches) {
+            list.clear();
+        }
+        learnedCount = 0;
+        learnedLimit = MinLearnedLimit;
+        unsatisfiable = false;
+
+        values.assign(variableCount, Unassigned);
+        savedPhases.assign(variableCount, False);
+        levels.assign(variableCount, 0);
+        reasons.assign(variableCount, NoClause);
+        trail.clear();
+        trailLimits.clear();
+        propagationHead = 0;
+
+        activities.assign(variableCount, 0.0);
+        variableIncrement = 1.0;
+        clauseIncrement = 1.0;
+        heap.clear();
+        heapPositions.assign(variableCount, NoVariable);
+        for (auto variable = 0U; variable < variableCount; variable++) {
+            insertHeap(variable);
+        }
+
+        decisionCount = 0;
+        conflictCount = 0;
+        restartCount = 0;
+        seen.assign(variableCount, 0);
+    }
+
+    unsigned getVariableCount() const {
+        return static_cast<unsigned>(values.size());
+    }
+
+    unsigned long long getDecisionCount() const {
+        return decisionCount;
+    }
+
+    unsigned long long getConflictCount() const {
+        return conflictCount;
+    }
+
+    // The value of a variable in the model after solve() returned
+    // Satisfiable.
+    bool getModelValue(unsigned variable) const {
+        return values[variable] == True;
+    }
+
+    // The value a variable has regardless of any decision, as far as the
+    // solver found out; Unassigned if it doesn't know.
+    Value getFixedValue(unsigned variable) const {
+        return levels[variable] == 0 || values[variable] == Unassigned
+            ? static_cast<Value>(values[variable])
+            : Unassigned;
+    }
+
+    // Adds the clause, the disjunction of the literals, which may be
+    // reordered. Returns false if the solver became unsatisfiable.
+    bool addClause(std::vector<Literal> &clause) {
+        if (unsatisfiable) {
+            return false;
+        }
+        backtrack(0);
+
+        // Literals fixed at the root decide the clause or drop out of it.
+        std::sort(clause.begin(), clause.end());
+        clause.erase(std::unique(clause.begin(), clause.end()), clause.end());
+        auto kept = 0U;
+        for (auto i = 0U; i < clause.size(); i++) {
+            const auto value = getValue(clause[i]);
+            if (value == True || (i + 1 < clause.size() && clause[i + 1] == negate(clause[i]))) {
+                return true;
+            }
+            if (value == Unassigned) {
+                clause[kept++] = clause[i];
+            }
+        }
+        clause.resize(kept);
+
+        if (clause.empty()) {
+            unsatisfiable = true;
+            return false;
+        }
+        if (clause.size() == 1) {
+            assign(clause[0], NoClause);
+            if (propagate() != NoClause) {
+                unsatisfiable = true;
+                return false;
+            }
+            return true;
+        }
+        attachClause(addStoredClause(clause, false));
+        return true;
+    }
+
+    // Searches for a model of the clauses. shouldStop(decisions) is called
+    // with the number of decisions before every decision, true stops the
+    // search.
+    template <typename ShouldStop>
+    Result solve(ShouldStop &&shouldStop) {
+        if (unsatisfiable) {
+            return Result::Unsatisfiable;
+        }
+        backtrack(0);
+
+        auto conflictsUntilRestart = RestartBase * getLubyNumber(restartCount);
+        while (true) {
+            const auto conflict = propagate();
+            if (conflict != NoClause) {
+                conflictCount++;
+                if (trailLimits.empty()) {
+                    unsatisfiable = true;
+                    return Result::Unsatisfiable;
+                }
+                learnFrom(conflict);
+                variableIncrement /= VariableDecay;
+                clauseIncrement /= ClauseDecay;
+
+                if (--conflictsUntilRestart == 0) {
+                    backtrack(0);
+                    restartCount++;
+                    conflictsUntilRestart = RestartBase * getLubyNumber(restartCount);
+                    if (learnedCount > learnedLimit) {
+                        reduceLearned();
+                    }
+                }
+                continue;
+            }
+
+            auto variable = NoVariable;
+            while (!heap.empty() && variable == NoVariable) {
+                variable = popHeap();
+                if (values[variable] != Unassigned) {
+                    variable = NoVariable;
+                }
+            }
+            if (variable == NoVariable) {
+                return Result::Satisfiable;
+            }
+            if (shouldStop(++decisionCount)) {
+                insertHeap(variable);
+                return Result::Unknown;
+            }
+            trailLimits.push_back(trail.size());
+            assign(makeLiteral(variable, savedPhases[variable] == True), NoClause);
+        }
+    }
+
+private:
+    // 1, 1, 2, 1, 1, 2, 4, 1, 1, 2, 1, 1, 2, 4, 8, ...
+    static unsigned getLubyNumber(unsigned index) {
+        auto size = 1U;
+        auto exponent = 0U;
+        while (size < index + 1) {
+            size = 2 * size + 1;
+            exponent++;
+        }
+        while (size - 1 != index) {
+            size = (size - 1) / 2;
+            exponent--;
+            index %= size;
+        }
+        return 1U << exponent;
+    }
+
+    uint8_t getValue(Literal literal) const {
+        const auto value = values[getVariable(literal)];
+        return value == Unassigned ? value : static_cast<uint8_t>(value ^ (literal & 1));
+    }
+
+    unsigned getLevel() const {
+        return static_cast<unsigned>(trailLimits.size());
+    }
+
+    void assign(Literal literal, unsigned reason) {
+        const auto variable = getVariable(literal);
+        values[variable] = (literal & 1) != 0 ? False : True;
+        levels[variable] = getLevel();
+        reasons[variable] = reason;
+        trail.push_back(literal);
+    }
+
+    void backtrack(unsigned level) {
+        if (getLevel() <= level) {
+            return;
+        }
+        for (auto i = trail.size(); i > trailLimits[level]; i--) {
+            const auto variable = getVariable(trail[i - 1]);
+            savedPhases[variable] = values[variable];
+            values[variable] = Unassigned;
+            reasons[variable] = NoClause;
+            if (heapPositions[variable] == NoVariable) {
+                insertHeap(variable);
+            }
+        }
+        trail.resize(trailLimits[level]);
+        trailLimits.resize(level);
+        propagationHead = trail.size();
+    }
+
+    unsigned addStoredClause(const std::vector<Literal> &clause, bool isLearned) {
+        const auto id = static_cast<unsigned>(clauses.size());
+        clauses.push_back({ static_cast<unsigned>(literals.size()), static_cast<unsigned>(clause.size()), isLearned, 0.0 });
+        literals.insert(literals.end(), clause.begin(), clause.end());
+        if (isLearned) {
+            learnedCount++;
+        }
+        return id;
+    }
+
+    void attachClause(unsigned id) {
+        const auto *clauseLiterals = &literals[clauses[id].start];
+        watches[clauseLiterals[0]].push_back({ id, clauseLiterals[1] });
+        watches[clauseLiterals[1]].push_back({ id, clauseLiterals[0] });
+    }
+
+    // Propagates the assignments on the trail. Returns the clause found
+    // false, NoClause if there is none.
+    unsigned propagate() {
+        while (propagationHead < trail.size()) {
+            const auto falseLiteral = negate(trail[propagationHead++]);
+            auto &list = watches[falseLiteral];
+            size_t kept = 0;
+            for (size_t i = 0; i < list.size(); i++) {
+                const auto watch = list[i];
+                if (getValue(watch.blocker) == True) {
+                    list[kept++] = watch;
+                    continue;
+                }
+
+                const auto &clause = clauses[watch.clause];
+                auto *clauseLiterals = &literals[clause.start];
+                if (clauseLiterals[0] == falseLiteral) {
+                    std::swap(clauseLiterals[0], clauseLiterals[1]);
+                }
+                const auto first = clauseLiterals[0];
+                if (first != watch.blocker && getValue(first) == True) {
+                    list[kept++] = { watch.clause, first };
+                    continue;
+                }
+
+                auto moved = false;
+                for (auto k = 2U; k < clause.size; k++) {
+                    if (getValue(clauseLiterals[k]) != False) {
+                        std::swap(clauseLiterals[1], clauseLiterals[k]);
+                        watches[clauseLiterals[1]].push_back({ watch.clause, first });
+                        moved = true;
+                        break;
+                    }
+                }
+                if (moved) {
+                    continue;
+                }
+
+                list[kept++] = { watch.clause, first };
+                if (getValue(first) == False) {
+                    for (i++; i < list.size(); i++) {
+                        list[kept++] = list[i];
+                    }
+                    list.resize(kept);
+                    propagationHead = trail.size();
+                    return watch.clause;
+                }
+                assign(first, watch.clause);
+            }
+            list.resize(kept);
+        }
+        return NoClause;
+    }
+
+    // Learns the first UIP clause of the conflict, jumps back to the level
+    // where it implies its first literal, and assigns that.
+    void learnFrom(unsigned conflict) {
+        learned.assign(1, 0);
+        analyzed.clear();
+        auto pathCount = 0U;
+        auto index = trail.size();
+        auto clauseId = conflict;
+        auto skipFirst = false;
+        Literal implied = 0;
+        do {
+            auto &clause = clauses[clauseId];
+            if (clause.learned) {
+                bumpClause(clause);
+            }
+            for (auto i = skipFirst ? 1U : 0U; i < clause.size; i++) {
+                const auto literal = literals[clause.start + i];
+                const auto variable = getVariable(literal);
+                if (seen[variable] == 0 && levels[variable] > 0) {
+                    seen[variable] = 1;
+                    analyzed.push_back(variable);
+                    bumpVariable(variable);
+                    if (levels[variable] >= getLevel()) {
+                        pathCount++;
+                    } else {
+                        learned.push_back(literal);
+                    }
+                }
+            }
+
+            while (seen[getVariable(trail[--index])] == 0) { }
+            implied = trail[index];
+            clauseId = reasons[getVariable(implied)];
+            seen[getVariable(implied)] = 0;
+            skipFirst = true;
+        } while (--pathCount > 0);
+        learned[0] = negate(implied);
+
+        // A literal whose reason only has literals of the clause or of the
+        // root can go.
+        auto kept = 1U;
+        for (auto i = 1U; i < learned.size(); i++) {
+            const auto reason = reasons[getVariable(learned[i])];
+            auto redundant = reason != NoClause;
+            if (redundant) {
+                const auto &clause = clauses[reason];
+                for (auto k = 1U; k < clause.size && redundant; k++) {
+                    const auto variable = getVariable(literals[clause.start + k]);
+                    redundant = seen[variable] != 0 || levels[variable] == 0;
+                }
+            }
+            if (!redundant) {
+                learned[kept++] = learned[i];
+            }
+        }
+        learned.resize(kept);
+        for (const auto variable : analyzed) {
+            seen[variable] = 0;
+        }
+
+        // The literal of the highest level after the first is watched.
+        auto level = 0U;
+        for (auto i = 1U; i < learned.size(); i++) {
+            if (levels[getVariable(learned[i])] > level) {
+                level = levels[getVariable(learned[i])];
+                std::swap(learned[1], learned[i]);
+            }
+        }
+
+        backtrack(level);
+        if (learned.size() == 1) {
+            assign(learned[0], NoClause);
+            return;
+        }
+        const auto id = addStoredClause(learned, true);
+        bumpClause(clauses[id]);
+        attachClause(id);
+        assign(learned[0], id);
+    }
+
+    // At the root, drops the learned clauses satisfied there and the less
+    // active half of the others, binary ones excepted.
+    void reduceLearned() {
+        std::vector<std::pair<double, unsigned>> candidates;
+        std::vector<uint8_t> removed(clauses.size(), 0);
+        for (auto id = 0U; id < clauses.size(); id++) {
+            const auto &clause = clauses[id];
+            if (!clause.learned) {
+                continue;
+            }
+            auto satisfied = false;
+            for (auto i = 0U; i < clause.size && !satisfied; i++) {
+                satisfied = getValue(literals[clause.start + i]) == True;
+            }
+            if (satisfied) {
+                removed[id] = 1;
+            } else if (clause.size > 2) {
+                candidates.emplace_back(clause.activity, id);
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+        for (size_t i = 0; i < candidates.size() / 2; i++) {
+            removed[candidates[i].second] = 1;
+        }
+
+        // Level 0 is never analyzed, so its reasons can go with the ids.
+        for (const auto literal : trail) {
+            reasons[getVariable(literal)] = NoClause;
+        }
+        std::vector<Clause> keptClauses;
+        std::vector<Literal> keptLiterals;
+        keptClauses.reserve(clauses.size());
+        keptLiterals.reserve(literals.size());
+        learnedCount = 0;
+        for (auto id = 0U; id < clauses.size(); id++) {
+            if (removed[id] != 0) {
+                continue;
+            }
+            auto clause = clauses[id];
+            const auto begin = literals.begin() + clause.start;
+            clause.start = static_cast<unsigned>(keptLiterals.size());
+            keptLiterals.insert(keptLiterals.end(), begin, begin + clause.size);
+            keptClauses.push_back(clause);
+            learnedCount += clause.learned ? 1 : 0;
+        }
+        clauses.swap(keptClauses);
+        literals.swap(keptLiterals);
+        for (auto &list : watches) {
+            list.clear();
+        }
+        for (auto id = 0U; id < clauses.size(); id++) {
+            attachClause(id);
+        }
+        learnedLimit *= 1.1;
+    }
+
+    void bumpVariable(unsigned variable) {
+        activities[variable] += variableIncrement;
+        if (activities[variable] > 1e100) {
+            for (auto &activity : activities) {
+                activity *= 1e-100;
+            }
+            variableIncrement *= 1e-100;
+        }
+        if (heapPositions[variable] != NoVariable) {
+            siftUp(heapPositions[variable]);
+        }
+    }
+
+    void bumpClause(Clause &clause) {
+        clause.activity += clauseIncrement;
+        if (clause.activity > 1e20) {
+            for (auto &other : clauses) {
+                other.activity *= 1e-20;
+            }
+            clauseIncrement *= 1e-20;
+        }
+    }
+
+    void insertHeap(unsigned variable) {
+        heapPositions[variable] = static_cast<unsigned>(heap.size());
+        heap.push_back(variable);
+        siftUp(heapPositions[variable]);
+    }
+
+    unsigned popHeap() {
+        const auto top = heap.front();
+        heapPositions[top] = NoVariable;
+        heap.front() = heap.back();
+        heap.pop_back();
+        if (!heap.empty()) {
+            heapPositions[heap.front()] = 0;
+            siftDown(0);
+        }
+        return top;
+    }
+
+    void siftUp(unsigned position) {
+        const auto variable = heap[position];
+        while (position > 0 && activities[heap[(position - 1) / 2]] < activities[variable]) {
+            heap[position] = heap[(position - 1) / 2];
+            heapPositions[heap[position]] = position;
+            position = (position - 1) / 2;
+        }
+        heap[position] = variable;
+        heapPositions[variable] = position;
+    }
+
+    void siftDown(unsigned position) {
+        const auto variable = heap[position];
+        while (2 * position + 1 < heap.size()) {
+            auto child = 2 * position + 1;
+            if (child + 1 < heap.size() && activities[heap[child + 1]] > activities[heap[child]]) {
+                child++;
+            }
+            if (activities[heap[child]] <= activities[variable]) {
+                break;
+            }
+            heap[position] = heap[child];
+            heapPositions[heap[position]] = position;
+            position = child;
+        }
+        heap[position] = variable;
+        heapPositions[variable] = position;
+    }
+};
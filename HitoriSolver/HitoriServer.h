@@ -0,0 +1,603 @@
+#pragma once
+
+#include "Hitori.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <signal.h>
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+
+// A request of the server protocol, one per line:
+//
+//   ID [first|unique|count] [deadline=MS] [nodes=N] ROW/ROW/...
+//
+// the values of a row separated by spaces, as in the compact output. The
+// response is a line starting with the ID, sent as soon as the request is
+// done, so responses can come in another order than the requests:
+//
+//   ID solved ROW/ROW/...  the solution, with deleted cells as -
+//   ID solutions N         the number of solutions, in count mode
+//   ID none                there is no solution
+//   ID multiple            there is more than one, in unique mode
+//   ID timeout             the deadline or the node limit ran out first
+//   ID error MESSAGE       the request couldn't be read
+struct ServerRequest {
+    std::string id;
+    SolveMode mode = SolveMode::First;
+    // The deadline counts from the arrival of the request, so it includes
+    // the time spent waiting for a worker. 0 means none.
+    std::chrono::milliseconds deadline = std::chrono::milliseconds::zero();
+    unsigned long long nodeLimit = 0;
+    TableValues values;
+};
+
+// Reads a request line into request, whose fields hold the defaults of the
+// server. A malformed line throws std::invalid_argument, with request.id
+// already set if the line has one.
+inline void parseServerRequest(const char *begin, const char *end, ServerRequest &request) {
+    const auto isSpace = [](char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    };
+    const auto nextToken = [&](const char *&p) {
+        while (p != end && isSpace(*p)) {
+            p++;
+        }
+        const auto start = p;
+        while (p != end && !isSpace(*p)) {
+            p++;
+        }
+        return std::string(start, p);
+    };
+    const auto parseNumber = [](const std::string &text, size_t offset) {
+        auto value = 0ULL;
+        const auto last = text.data() + text.size();
+        const auto parsed = std::from_chars(text.data() + offset, last, value);
+        if (parsed.ec != std::errc() || parsed.ptr != last) {
+            throw std::invalid_argument("invalid number in " + text);
+        }
+        return value;
+    };
+
+    auto p = begin;
+    request.id = nextToken(p);
+    while (true) {
+        while (p != end && isSpace(*p)) {
+            p++;
+        }
+        if (p == end || (*p >= '0' && *p <= '9')) {
+            break;
+        }
+
+        const auto option = nextToken(p);
+        if (option == "first") {
+            request.mode = SolveMode::First;
+        } else if (option == "unique") {
+            request.mode = SolveMode::Unique;
+        } else if (option == "count") {
+            request.mode = SolveMode::Count;
+        } else if (option.compare(0, 9, "deadline=") == 0) {
+            request.deadline = std::chrono::milliseconds(parseNumber(option, 9));
+        } else if (option.compare(0, 6, "nodes=") == 0) {
+            request.nodeLimit = parseNumber(option, 6);
+        } else {
+            throw std::invalid_argument("unknown option " + option);
+        }
+    }
+
+    // The board: rows separated by '/', each as long as there are rows.
+    auto &values = request.values;
+    values.size = 0;
+    values.values.clear();
+    auto rowCount = 0U;
+    auto rowLength = 0U;
+    while (true) {
+        while (p != end && isSpace(*p)) {
+            p++;
+        }
+        if (p == end || *p == '/') {
+            if (rowLength == 0 || (rowCount != 0 && rowLength != values.size)) {
+                throw std::invalid_argument("invalid table shape");
+            }
+            values.size = rowLength;
+            rowCount++;
+            rowLength = 0;
+            if (p == end) {
+                break;
+            }
+            p++;
+            continue;
+        }
+
+        auto value = 0U;
+        const auto parsed = std::from_chars(p, end, value);
+        if (parsed.ec != std::errc() || (parsed.ptr != end && !isSpace(*parsed.ptr) && *parsed.ptr != '/')) {
+            throw std::invalid_argument("invalid value");
+        }
+        values.values.push_back(value);
+        rowLength++;
+        p = parsed.ptr;
+    }
+
+    if (rowCount != values.size || values.size > TableBase::MaxSize) {
+        throw std::invalid_argument("invalid table shape");
+    }
+    for (const auto value : values.values) {
+        if (value == 0 || value > values.size) {
+            throw std::invalid_argument("invalid value");
+        }
+    }
+}
+
+// The response line to a solved request.
+inline void appendServerResponse(std::string &out, const ServerRequest &request, const SolveResult &result) {
+    out += request.id;
+    if (result.timedOut) {
+        out += " timeout\n";
+
+    } else if (request.mode == SolveMode::Count) {
+        out += " solutions ";
+        out += std::to_string(result.solutionCount);
+        out += '\n';
+
+    } else if (result.solutionCount == 0) {
+        out += " none\n";
+
+    } else if (!result.success) {
+        out += " multiple\n";
+
+    } else {
+        std::vector<uint8_t> deleted(request.values.values.size());
+        for (auto pos = 0U; pos < deleted.size(); pos++) {
+            deleted[pos] = static_cast<uint8_t>(CorpusFormat::unpack(result.solutionMask.data(), pos, 1));
+        }
+        out += " solved ";
+        TableFormatter::append(out, request.values, deleted, TableFormatter::Style::Compact);
+    }
+}
+
+// The client side of a stream of requests: where the responses go, how
+// many of its requests are still being solved and how much of the
+// responses is still to be written.
+class ServerConnection {
+public:
+    // Writes all of the bytes, returns false if the client is gone.
+    using Output = std::function<bool(const char *data, size_t size)>;
+
+private:
+    Output output;
+    std::mutex mutex;
+    std::condition_variable drained;
+    std::condition_variable outputWritten;
+    std::string buffer;
+    std::string writeBuffer;
+    unsigned pending;
+    bool writing;
+    bool failed;
+    CancellationToken closed;
+
+public:
+    explicit ServerConnection(Output output):
+        output(std::move(output)),
+        pending(0),
+        writing(false),
+        failed(false) { }
+
+    const CancellationToken &getCancellationToken() const {
+        return closed;
+    }
+
+    void beginRequest() {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending++;
+    }
+
+    // Sends the response to a request started with beginRequest. Responses
+    // that finish while another worker is writing are sent together by that
+    // worker, so a busy connection takes few writes without delaying any.
+    void respond(const std::string &response) {
+        std::unique_lock<std::mutex> lock(mutex);
+        buffer += response;
+        pending--;
+        if (!writing) {
+            writing = true;
+            while (!buffer.empty()) {
+                writeBuffer.swap(buffer);
+                lock.unlock();
+                const auto written = failed || output(writeBuffer.data(), writeBuffer.size());
+                lock.lock();
+                writeBuffer.clear();
+                if (!written) {
+                    // The client is gone, its requests in flight can stop.
+                    failed = true;
+                    closed.cancel();
+                }
+                outputWritten.notify_all();
+            }
+            writing = false;
+        }
+        if (pending == 0 && !writing) {
+            drained.notify_all();
+        }
+    }
+
+    // Waits while more than maxUnsent bytes of responses wait to be
+    // written, or until the client is gone.
+    void waitForOutput(size_t maxUnsent) {
+        std::unique_lock<std::mutex> lock(mutex);
+        outputWritten.wait(lock, [&]() {
+            return failed || buffer.size() + writeBuffer.size() <= maxUnsent;
+        });
+    }
+
+    // Waits until every request has its response written.
+    void finish() {
+        std::unique_lock<std::mutex> lock(mutex);
+        drained.wait(lock, [this]() {
+            return pending == 0 && !writing;
+        });
+    }
+};
+
+// Solves the requests of any number of connections on a pool of warm
+// workers, whose tables are kept from one request to the next by
+// ThreadWorkspace. At most maxPending requests, of all the connections
+// together, are queued or being solved; past that submit blocks the reading
+// of the connection submitting. A client sending faster than the workers
+// solve thus holds back every connection that submits while the slots are
+// taken, not only its own. A connection also stops being read while more
+// than MaxUnsentSize bytes of its responses wait to be written, so a client
+// that doesn't read them can't fill the memory.
+class SolveServer {
+public:
+    // A request line is at most MaxRequestSize bytes long, a 255x255 board
+    // takes up to about 260 KB. A longer one is answered with an error.
+    static constexpr size_t MaxRequestSize = 1 << 20;
+    static constexpr size_t MaxUnsentSize = 1 << 20;
+
+    struct Stats {
+        unsigned long long requests = 0;
+        unsigned long long errors = 0;
+        unsigned long long timeouts = 0;
+        SearchStats search;
+    };
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    SolveOptions options;
+    ServerRequest defaults;
+    unsigned maxPending;
+    std::mutex mutex;
+    std::condition_variable slotFree;
+    unsigned pending;
+    Stats stats;
+    ThreadPool pool;
+
+public:
+    // The mode, the time and node limits and the cache of options are the
+    // defaults of the requests.
+    SolveServer(const SolveOptions &options, unsigned jobCount, unsigned maxPending):
+        options(options),
+        maxPending(std::max(maxPending, 1U)),
+        pending(0),
+        pool(std::max(jobCount, 1U)) {
+
+        this->options.threadCount = 1;
+        this->options.format = OutputFormat::Binary;
+        defaults.mode = options.mode;
+        defaults.deadline = options.timeLimit;
+        defaults.nodeLimit = options.nodeLimit;
+    }
+
+    ~SolveServer() {
+        std::unique_lock<std::mutex> lock(mutex);
+        slotFree.wait(lock, [this]() {
+            return pending == 0;
+        });
+    }
+
+    Stats getStats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+
+    // Queues the request on a line, blank lines are skipped. Malformed
+    // requests are answered at once.
+    void submit(const std::shared_ptr<ServerConnection> &connection, const char *begin, const char *end) {
+        const auto arrival = Clock::now();
+        auto request = std::make_shared<ServerRequest>(defaults);
+        try {
+            parseServerRequest(begin, end, *request);
+        } catch (const std::invalid_argument &e) {
+            reject(*connection, request->id, e.what());
+            return;
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            slotFree.wait(lock, [this]() {
+                return pending < maxPending;
+            });
+            pending++;
+            stats.requests++;
+        }
+        connection->beginRequest();
+        pool.submit([this, connection, request, arrival]() {
+            solve(*connection, *request, arrival);
+        });
+    }
+
+    // Reads line delimited requests with read, which returns the number of
+    // bytes read, 0 at the end and a negative number on errors, until the
+    // end of the stream. Returns once every response is written.
+    template <typename Read>
+    void serve(const std::shared_ptr<ServerConnection> &connection, Read &&read) {
+        std::vector<char> buffer(1 << 16);
+        size_t used = 0;
+        // The rest of a line too long to be a request is dropped.
+        auto skipping = false;
+        while (!connection->getCancellationToken().isCancelled()) {
+            if (used == buffer.size()) {
+                if (buffer.size() < MaxRequestSize) {
+                    buffer.resize(std::min(buffer.size() * 2, MaxRequestSize));
+                } else {
+                    if (!skipping) {
+                        const auto idStart = std::find_if(buffer.begin(), buffer.end(), [](char c) {
+                            return c != ' ' && c != '\t' && c != '\r';
+                        });
+                        const auto idEnd = std::find_if(idStart, buffer.end(), [](char c) {
+                            return c == ' ' || c == '\t' || c == '\r';
+                        });
+                        reject(*connection, std::string(idStart, idEnd), "request too long");
+                        skipping = true;
+                    }
+                    used = 0;
+                }
+            }
+            connection->waitForOutput(MaxUnsentSize);
+            const auto count = read(buffer.data() + used, buffer.size() - used);
+            if (count <= 0) {
+                break;
+            }
+
+            const auto first = buffer.data();
+            const auto last = first + used + static_cast<size_t>(count);
+            auto lineStart = first;
+            for (auto p = first + used; p != last; p++) {
+                if (*p == '\n') {
+                    if (!skipping) {
+                        submit(connection, lineStart, p);
+                    }
+                    skipping = false;
+                    lineStart = p + 1;
+                }
+            }
+            used = static_cast<size_t>(last - lineStart);
+            std::memmove(first, lineStart, used);
+        }
+        if (used != 0 && !skipping) {
+            submit(connection, buffer.data(), buffer.data() + used);
+        }
+        connection->finish();
+    }
+
+private:
+    // Answers a request that can't be solved with an error at once. A line
+    // without an ID can't be answered, it is skipped.
+    void reject(ServerConnection &connection, const std::string &id, const std::string &message) {
+        if (id.empty()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stats.requests++;
+            stats.errors++;
+        }
+        connection.beginRequest();
+        connection.respond(id + " error " + message + '\n');
+    }
+
+    void solve(ServerConnection &connection, const ServerRequest &request, Clock::time_point arrival) {
+        std::string response;
+        SolveResult result;
+        auto requestOptions = options;
+        requestOptions.mode = request.mode;
+        requestOptions.nodeLimit = request.nodeLimit;
+        requestOptions.cancellationToken = &connection.getCancellationToken();
+
+        // A request that waited past its deadline isn't started at all.
+        requestOptions.timeLimit = std::chrono::milliseconds::zero();
+        auto expired = false;
+        if (request.deadline != std::chrono::milliseconds::zero()) {
+            const auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - arrival);
+            expired = waited >= request.deadline;
+            requestOptions.timeLimit = request.deadline - waited;
+        }
+
+        try {
+            if (expired) {
+                result.timedOut = true;
+            } else {
+                result = solveTable(request.values, requestOptions);
+            }
+            appendServerResponse(response, request, result);
+        } catch (const std::exception &e) {
+            result.error = e.what();
+            response = request.id + " error " + result.error + '\n';
+        }
+        connection.respond(response);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stats.search.merge(result.stats);
+            stats.errors += result.error.empty() ? 0 : 1;
+            stats.timeouts += result.timedOut ? 1 : 0;
+            pending--;
+        }
+        slotFree.notify_all();
+    }
+};
+
+// Serves requests read from stdin, with the responses written to stdout,
+// until the end of the input.
+inline void serveStandardStreams(SolveServer &server) {
+    const auto connection = std::make_shared<ServerConnection>([](const char *data, size_t size) {
+        while (size != 0) {
+#ifdef _WIN32
+            const auto written = _write(1, data, static_cast<unsigned>(std::min<size_t>(size, 1 << 30)));
+#else
+            const auto written = ::write(1, data, size);
+#endif
+            if (written <= 0) {
+                return false;
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+    });
+    server.serve(connection, [](char *data, size_t size) -> long long {
+#ifdef _WIN32
+        return _read(0, data, static_cast<unsigned>(std::min<size_t>(size, 1 << 30)));
+#else
+        return ::read(0, data, size);
+#endif
+    });
+}
+
+#ifndef _WIN32
+// Binds a TCP socket to [HOST:]PORT, any host if there is none. Returns the
+// socket, or -1 if it can't be bound.
+inline int openTcpListener(const std::string &hostPort) {
+    const auto colon = hostPort.rfind(':');
+    const auto host = colon != std::string::npos ? hostPort.substr(0, colon) : std::string();
+    const auto port = colon != std::string::npos ? hostPort.substr(colon + 1) : hostPort;
+
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo *addresses = nullptr;
+    if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &addresses) != 0) {
+        return -1;
+    }
+    auto listener = -1;
+    for (auto a = addresses; a != nullptr && listener < 0; a = a->ai_next) {
+        listener = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        const auto reuse = 1;
+        if (listener >= 0 &&
+            (setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+             bind(listener, a->ai_addr, a->ai_addrlen) != 0)) {
+            close(listener);
+            listener = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    return listener;
+}
+
+// Listens on unix:PATH or tcp:[HOST:]PORT and serves every connection on a
+// thread of its own, until the process is stopped. While maxConnections are
+// served, new ones wait in the listen backlog. Returns an error message if
+// the socket can't be opened.
+inline std::string serveSocket(SolveServer &server, const std::string &address, unsigned maxConnections) {
+    // A client that goes away fails its writes instead of killing us.
+    signal(SIGPIPE, SIG_IGN);
+
+    auto listener = -1;
+    if (address.compare(0, 5, "unix:") == 0) {
+        const auto path = address.substr(5);
+        sockaddr_un socketAddress = {};
+        if (path.empty() || path.size() >= sizeof(socketAddress.sun_path)) {
+            return "invalid socket path " + path;
+        }
+        socketAddress.sun_family = AF_UNIX;
+        std::memcpy(socketAddress.sun_path, path.c_str(), path.size() + 1);
+
+        unlink(path.c_str());
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0 || bind(listener, reinterpret_cast<sockaddr *>(&socketAddress), sizeof(socketAddress)) != 0) {
+            return "unable to bind " + path;
+        }
+
+    } else if (address.compare(0, 4, "tcp:") == 0) {
+        listener = openTcpListener(address.substr(4));
+        if (listener < 0) {
+            return "unable to bind " + address.substr(4);
+        }
+
+    } else {
+        return "invalid address " + address + ", expected stdin, unix:PATH or tcp:[HOST:]PORT";
+    }
+
+    if (listen(listener, SOMAXCONN) != 0) {
+        close(listener);
+        return "unable to listen on " + address;
+    }
+
+    std::mutex mutex;
+    std::condition_variable connectionClosed;
+    auto connectionCount = 0U;
+    // Out of file descriptors or memory, accept fails until some are freed:
+    // wait a little longer after every failure in a row.
+    const auto minBackoff = std::chrono::milliseconds(10);
+    const auto maxBackoff = std::chrono::milliseconds(1000);
+    auto backoff = minBackoff;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            connectionClosed.wait(lock, [&]() {
+                return connectionCount < std::max(maxConnections, 1U);
+            });
+        }
+
+        const auto client = accept(listener, nullptr, nullptr);
+        if (client < 0) {
+            if (errno != EINTR && errno != ECONNABORTED) {
+                std::this_thread::sleep_for(backoff);
+                backoff = std::min(2 * backoff, maxBackoff);
+            }
+            continue;
+        }
+        backoff = minBackoff;
+        // Responses are small and sent as they are done, so Nagle's
+        // algorithm would only add latency. Fails harmlessly on unix sockets.
+        const auto noDelay = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            connectionCount++;
+        }
+        std::thread([&server, &mutex, &connectionClosed, &connectionCount, client]() {
+            const auto connection = std::make_shared<ServerConnection>([client](const char *data, size_t size) {
+                while (size != 0) {
+                    const auto written = send(client, data, size, 0);
+                    if (written <= 0) {
+                        return false;
+                    }
+                    data += written;
+                    size -= static_cast<size_t>(written);
+                }
+                return true;
+            });
+            server.serve(connection, [client](char *data, size_t size) -> long long {
+                return recv(client, data, size, 0);
+            });
+            close(client);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            connectionCount--;
+            connectionClosed.notify_one();
+        }).detach();
+    }
+}
+#endif
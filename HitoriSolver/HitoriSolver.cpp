@@ -1,447 +1,807 @@
-#include <iostream>
-#include <iomanip>
+#include "Hitori.h"
+#include "HitoriServer.h"
+#include "HitoriCluster.h"
+
 #include <fstream>
-#include <vector>
-#include <string>
-#include <sstream>
+#include <filesystem>
+
+// Collects the input files: directories are expanded to the regular files
+// in them, in name order.
+std::vector<std::string> collectInputFiles(const std::vector<std::string> &inputs) {
+    std::vector<std::string> files;
+    for (const auto &input : inputs) {
+        std::error_code error;
+        if (input != "-" && std::filesystem::is_directory(input, error)) {
+            std::vector<std::string> directoryFiles;
+            for (const auto &entry : std::filesystem::directory_iterator(input)) {
+                if (entry.is_regular_file()) {
+                    directoryFiles.push_back(entry.path().string());
+                }
+            }
+            std::sort(directoryFiles.begin(), directoryFiles.end());
+            files.insert(files.end(), directoryFiles.begin(), directoryFiles.end());
 
-class DisjointSets {
+        } else {
+            files.push_back(input);
+        }
+    }
+    return files;
+}
+
+// Reads the tables of the input files one at a time, text tables and binary
+// corpora alike, - being stdin, so a batch of any size isn't held in memory.
+// The tables are named like readPuzzles does. A malformed table, or a file
+// that can't be read, becomes a Puzzle with an error message.
+class PuzzleReader {
 private:
-    std::vector<int> parents;
+    std::vector<std::string> files;
+    size_t nextFile;
+    std::string name;
+    std::ifstream file;
+    std::unique_ptr<TableReader> tableReader;
+    std::unique_ptr<CorpusReader> corpusReader;
+    size_t recordCount;
+    // The number of tables of the file read so far. A text file is read
+    // one table ahead, to tell whether it holds more than one.
+    size_t tableCount;
+    Puzzle ahead;
+    bool hasAhead;
 
 public:
-    DisjointSets(unsigned size):
-        parents(size, -1) { }
+    explicit PuzzleReader(std::vector<std::string> files):
+        files(std::move(files)),
+        nextFile(0),
+        recordCount(0),
+        tableCount(0),
+        hasAhead(false) { }
+
+    // Reads the next table into puzzle, returns false after the last one.
+    bool read(Puzzle &puzzle) {
+        while (true) {
+            if (corpusReader && tableCount < recordCount) {
+                puzzle = Puzzle();
+                try {
+                    corpusReader->read(tableCount, puzzle.values);
+                } catch (const std::exception &e) {
+                    puzzle.error = e.what();
+                }
+                tableCount++;
+                puzzle.id = recordCount > 1 ? name + ":" + std::to_string(tableCount) : name;
+                return true;
+            }
 
-    int findSet(int e) {
-        assertElementRange(e);
+            if (tableReader && hasAhead) {
+                puzzle = std::move(ahead);
+                tableCount++;
+                hasAhead = readTable(ahead);
+                puzzle.id = tableCount > 1 || hasAhead ? name + ":" + std::to_string(tableCount) : name;
+                return true;
+            }
 
-        auto root = e;
-        while (parents[root] >= 0) {
-            root = parents[root];
+            if (nextFile == files.size()) {
+                return false;
+            }
+            if (!open(files[nextFile++], puzzle)) {
+                return true;
+            }
         }
+    }
 
-        while (parents[e] >= 0) {
-            const auto parent = parents[e];
-            parents[e] = root;
-            e = parent;
+private:
+    // Starts reading path. Returns false, with the error in puzzle, if it
+    // can't be read.
+    bool open(const std::string &path, Puzzle &puzzle) {
+        tableReader.reset();
+        corpusReader.reset();
+        file.close();
+        file.clear();
+        recordCount = 0;
+        tableCount = 0;
+        hasAhead = false;
+        name = path == "-" ? "stdin" : path;
+
+        if (path == "-") {
+            tableReader.reset(new TableReader(std::cin));
+            hasAhead = readTable(ahead);
+            return true;
         }
 
-        return root;
+        puzzle = Puzzle();
+        puzzle.id = name;
+        file.open(path, std::ios::binary);
+        if (!file.good()) {
+            puzzle.error = "Unable to open " + path + " for reading";
+            return false;
+        }
+        try {
+            if (isCorpus(file)) {
+                corpusReader.reset(new CorpusReader(file));
+                recordCount = corpusReader->getRecordCount();
+                return true;
+            }
+        } catch (const std::exception &e) {
+            puzzle.error = e.what();
+            return false;
+        }
+        tableReader.reset(new TableReader(file));
+        hasAhead = readTable(ahead);
+        return true;
     }
 
-    void unionSets(int e1, int e2) {
-        const auto root1 = findSet(e1);
-        const auto root2 = findSet(e2);
-        linkSets(root1, root2);
+    // Reads the next table of the text file into puzzle, returns false at
+    // its end.
+    bool readTable(Puzzle &puzzle) {
+        puzzle = Puzzle();
+        try {
+            return tableReader->read(puzzle.values);
+        } catch (const std::exception &e) {
+            puzzle.error = e.what();
+            return true;
+        }
     }
+};
 
-    void linkSets(int set1, int set2) {
-        assertElementRange(set1);
-        assertElementRange(set2);
+// Prints the counters of a search, times in milliseconds.
+void printStats(std::ostream &out, const SearchStats &stats) {
+    out << "nodes: " << stats.nodes << '\n';
+    out << "branch points: " << stats.branchPoints << '\n';
+#ifdef HITORI_ENABLE_STATS
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+    const auto propagationTime = Milliseconds(stats.propagationTime).count();
+    const auto searchTime = Milliseconds(stats.searchTime).count();
+
+    out << "finalizeCell calls: " << stats.finalizeCalls << '\n';
+    out << "deleteCell calls: " << stats.deleteCalls << '\n';
+    for (auto i = 1U; i < TableBase::ConflictCount; i++) {
+        out << "conflicts, " << TableBase::getConflictName(static_cast<TableBase::Conflict>(i)) << ": " << stats.conflicts[i] << '\n';
+    }
+    out << "max depth: " << stats.maxDepth << '\n';
+    out << "backjumps: " << stats.backjumps << '\n';
+    out << "propagation ms: " << propagationTime << '\n';
+    out << "branching ms: " << std::max(searchTime - propagationTime, 0.0) << '\n';
+#else
+    out << "build with HITORI_ENABLE_STATS defined for the detailed counters\n";
+#endif
+}
 
-        if (parents[set1] >= 0 || parents[set2] >= 0) {
-            throw std::logic_error("at least one element is not root");
+void printCacheStats(std::ostream &out, const SolveCache::Stats &stats) {
+    out << "cache hits: " << stats.hits << '\n';
+    out << "cache misses: " << stats.misses << '\n';
+    out << "cache hit rate: " << (stats.hits + stats.misses != 0 ? 100.0 * stats.hits / (stats.hits + stats.misses) : 0.0) << "%\n";
+    out << "cache entries: " << stats.size << " of " << stats.capacity << '\n';
+    out << "cache evictions: " << stats.evictions << '\n';
+}
+
+// Writes the cache to a temporary file first, so an interrupted run leaves
+// the previous cache file intact.
+bool saveCache(SolveCache &cache, const std::string &file) {
+    const auto temporaryFile = file + ".tmp";
+    {
+        std::ofstream out(temporaryFile, std::ios::binary | std::ios::trunc);
+        if (!out.good()) {
+            return false;
+        }
+        cache.save(out);
+        if (!out.good()) {
+            return false;
         }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryFile, file, error);
+    return !error;
+}
 
-        if (set1 != set2) {
-            const auto rank1 = -parents[set1] - 1;
-            const auto rank2 = -parents[set2] - 1;
-            if (rank1 < rank2) {
-                parents[set1] = set2;
+// Prints the command line and its options.
+void printUsage() {
+    std::cout << "Usage: HitoriSolver [--count|--unique] [--threads N] [--jobs N] [--format grid|compact|mask] [--stats]\n";
+    std::cout << "                    [--time-limit MS] [--node-limit N] [--learn] [--backend search|sat|auto]\n";
+    std::cout << "                    [--cache FILE] [--cache-size N]\n";
+    std::cout << "                    [--output FILE [--pack]] [--explain] <table.txt|corpus|directory|->...\n";
+    std::cout << "       HitoriSolver --generate N [--size N] [--min-branches N] [--max-branches N] [--seed N] [--jobs N]\n";
+    std::cout << "                    [--stats] [--output FILE]\n";
+    std::cout << "       HitoriSolver --serve stdin|unix:PATH|tcp:[HOST:]PORT [--max-pending N] [--max-clients N] [--jobs N]\n";
+    std::cout << "                    [--count|--unique] [--time-limit MS] [--node-limit N] [--cache FILE] [--cache-size N]\n";
+    std::cout << "                    [--stats]\n";
+    std::cout << "       HitoriSolver --coordinate tcp:[HOST:]PORT --output FILE [--checkpoint DIR] [--shard-size N]\n";
+    std::cout << "                    [--lease MS] [--retries N] [--count|--unique] [--time-limit MS] [--node-limit N]\n";
+    std::cout << "                    [--learn] [--backend search|sat|auto] [--stats] <corpus>\n";
+    std::cout << "       HitoriSolver --work tcp:HOST:PORT [--jobs N] [--cache FILE] [--cache-size N] [--stats]\n";
+    std::cout << "  --count          count the minimal solutions instead of printing one\n";
+    std::cout << "  --unique         print the solution only if it is the only minimal one\n";
+    std::cout << "  --threads N      search a single table on N threads, 0 uses every hardware thread\n";
+    std::cout << "  --jobs N         solve N tables of a batch at a time, defaults to every hardware thread\n";
+    std::cout << "  --format S       print solutions as a grid, on one line (compact) or as a 0/1 mask\n";
+    std::cout << "  --time-limit MS  give up on a table after MS milliseconds, printing what was deduced\n";
+    std::cout << "  --node-limit N   give up on a table after searching N nodes\n";
+    std::cout << "  --backend S      search the tables depth first, as CNF with a SAT solver, or pick by size and difficulty\n";
+    std::cout << "  --learn          learn nogoods from the conflicts of the search to prune it\n";
+    std::cout << "  --explain        solve step by step, printing every deduction and the rule behind it\n";
+    std::cout << "  --stats          print the search counters, summed over every table, to stderr\n";
+    std::cout << "  --output FILE    write the tables and their solutions to a binary corpus\n";
+    std::cout << "  --pack           write the tables to the corpus without solving them\n";
+    std::cout << "  --cache FILE     reuse the results of earlier runs kept in FILE, and add the new ones\n";
+    std::cout << "  --cache-size N   keep at most N results in the cache, 1048576 by default\n";
+    std::cout << "  --generate N     print N puzzles with a unique solution, or write them to the corpus\n";
+    std::cout << "  --size N         the size of the generated puzzles, 10 by default\n";
+    std::cout << "  --min-branches N keep the puzzles whose uniqueness proof takes at least N branch points\n";
+    std::cout << "  --max-branches N keep the puzzles whose uniqueness proof takes at most N branch points\n";
+    std::cout << "  --seed N         seed of the generator, the same seed gives the same puzzles\n";
+    std::cout << "  --serve ADDRESS  solve requests of one line each, streaming back one line per result\n";
+    std::cout << "  --max-pending N  stop reading requests while N are being solved, 64 per job by default\n";
+    std::cout << "  --max-clients N  serve at most N connections at a time, 1024 by default\n";
+    std::cout << "  --coordinate A   hand out the corpus in shards to the workers connecting to A, merging the results\n";
+    std::cout << "  --checkpoint DIR keep the solved shards in DIR to resume from, FILE.shards by default\n";
+    std::cout << "  --shard-size N   tables per shard, 1024 by default\n";
+    std::cout << "  --lease MS       hand a shard out again after its worker sent nothing for MS, 600000 by default\n";
+    std::cout << "  --retries N      give up on a shard lost by more than N workers, 3 by default\n";
+    std::cout << "  --work A         solve the shards of the coordinator at A until it has none left, with the\n";
+    std::cout << "                   mode, limits, backend and learning of the coordinator\n";
+    std::cout << "  --help           print this text\n";
+    std::cout << "Tables within a file are separated by blank lines, - reads from stdin.\n";
+    std::cout << "Binary corpus files are recognized by their header.\n";
+    std::cout << "Solutions are counted and searched among the minimal ones, where every deleted cell has a\n";
+    std::cout << "final copy of its value in its row or column; a board with any solution has a minimal one.\n";
+    std::cout << "A request is: ID [first|unique|count] [deadline=MS] [nodes=N] ROW/ROW/..., the limits\n";
+    std::cout << "default to --time-limit and --node-limit, the deadline includes the time spent queued.\n";
+}
 
-            } else if (rank2 < rank1) {
-                parents[set2] = set1;
+// Parses the whole of text as a number. Returns false if it isn't one.
+template <typename Number>
+bool parseNumber(const char *text, Number &value) {
+    const auto last = text + std::strlen(text);
+    const auto parsed = std::from_chars(text, last, value);
+    return parsed.ec == std::errc() && parsed.ptr == last;
+}
 
-            } else {
-                parents[set1] = set2;
-                parents[set2]--;
-            }
+// Writes generated puzzles as text tables, or with their solutions to a
+// binary corpus. Returns the exit code.
+int writeGeneratedPuzzles(const GeneratorOptions &options, unsigned long long count, unsigned jobCount,
+                          const std::string &outputFile, SearchStats &totalStats) {
+    std::ofstream file;
+    std::unique_ptr<CorpusWriter> writer;
+    if (!outputFile.empty()) {
+        file.open(outputFile, std::ios::binary | std::ios::trunc);
+        if (!file.good()) {
+            std::cout << "Unable to open " << outputFile << " for writing\n";
+            return 1;
         }
+        writer.reset(new CorpusWriter(file));
     }
 
-private:
-    void assertElementRange(int e) {
-        if (e < 0 || static_cast<size_t>(e) >= parents.size()) {
-            throw std::range_error("element index is out of range");
+    // Failures go to stderr, so the output stays readable as tables.
+    std::string text;
+    const auto success = generatePuzzles(options, count, jobCount, [&](const GeneratedPuzzle &generated) {
+        if (!generated.result.success) {
+            std::cerr << "# " << generated.puzzle.id << '\n' << generated.result.error << "\n\n";
+            return;
+        }
+        totalStats.merge(generated.result.stats);
+        if (writer) {
+            writer->write(generated.puzzle.values, &generated.result);
+            return;
         }
-    }
-};
 
-class Table {
-public:
-    class Cell {
-    public:
-        enum class State {
-            Unknown,
-            Final,
-            Deleted
-        };
+        if (!text.empty()) {
+            text += '\n';
+        }
+        TableFormatter::append(text, generated.puzzle.values);
+        if (text.size() >= (1 << 16)) {
+            std::cout.write(text.data(), static_cast<std::streamsize>(text.size()));
+            text.clear();
+            text += '\n';
+        }
+    });
 
-    private:
-        const unsigned value;
-        State state;
+    if (writer) {
+        writer->finish();
+        if (!file.good()) {
+            std::cout << "Unable to write " << outputFile << '\n';
+            return 1;
+        }
+    } else {
+        std::cout.write(text.data(), static_cast<std::streamsize>(text.size()));
+        std::cout.flush();
+    }
+    return success ? 0 : 2;
+}
 
-    public:
-        Cell(unsigned value):
-            value(value),
-            state(State::Unknown) { }
+#ifndef _WIN32
+// Solves the corpus in inputFile on the workers connecting to address, then
+// writes the results to outputFile. Returns the exit code.
+int coordinateShards(const std::string &address, const std::string &inputFile, const std::string &outputFile,
+                     const std::string &checkpointDirectory, const SolveOptions &options, size_t shardSize,
+                     std::chrono::milliseconds lease, unsigned retryLimit, bool showStats) {
+    std::ifstream in(inputFile, std::ios::binary);
+    if (!in.good()) {
+        std::cout << "Unable to open " << inputFile << " for reading\n";
+        return 1;
+    }
 
-        unsigned getValue() const {
-            return value;
+    try {
+        if (!isCorpus(in)) {
+            throw std::runtime_error(inputFile + " is not a corpus");
+        }
+        CorpusReader reader(in);
+        ShardCoordinator coordinator(reader, options, shardSize, checkpointDirectory, lease, retryLimit);
+        const auto error = coordinator.run(address);
+        if (!error.empty()) {
+            std::cout << error << '\n';
+            return 1;
         }
 
-        State getState() const {
-            return state;
+        std::ofstream out(outputFile, std::ios::binary | std::ios::trunc);
+        if (!out.good()) {
+            std::cout << "Unable to open " << outputFile << " for writing\n";
+            return 1;
+        }
+        auto success = true;
+        SearchStats totalStats;
+        coordinator.merge(out, [&](size_t index, const SolveResult &result) {
+            if (!result.error.empty()) {
+                std::cout << "# " << inputFile << ':' << index + 1 << '\n' << result.error << "\n\n";
+            }
+            success = success && isSolved(result, options.mode);
+            totalStats.merge(result.stats);
+        });
+        if (!out.good()) {
+            std::cout << "Unable to write " << outputFile << '\n';
+            return 1;
         }
 
-        void setState(State newState) {
-            state = newState;
+        if (showStats) {
+            const auto stats = coordinator.getStats();
+            printStats(std::cerr, totalStats);
+            std::cerr << "shards: " << stats.shards << '\n';
+            std::cerr << "shards resumed: " << stats.resumedShards << '\n';
+            std::cerr << "shards retried: " << stats.retries << '\n';
+            std::cerr << "shards failed: " << stats.failedShards << '\n';
+            std::cerr << "worker connections: " << stats.workers << '\n';
         }
-    };
+        return success ? 0 : 2;
 
-    class InvalidShapeException: public std::length_error {
-    public:
-        InvalidShapeException():
-            std::length_error("table shape is invalid") { }
-    };
+    } catch (const std::exception &e) {
+        std::cout << e.what() << '\n';
+        return 1;
+    }
+}
+#endif
+
+// Solves a table step by step with the hints of HintFinder, one line per
+// step, then the board as far as the hints got. Returns whether they
+// solved it.
+bool explainTable(const TableValues &values, TableFormatter::Style style, std::string &text) {
+    using State = TableBase::Cell::State;
+    HintFinder finder;
+    std::vector<State> states(values.values.size(), State::Unknown);
+    Hint hint;
+    while (finder.find(values, states, hint)) {
+        states[hint.row * values.size + hint.column] = hint.state;
+        text += "row " + std::to_string(hint.row + 1) + ", column " + std::to_string(hint.column + 1) + ": ";
+        text += hint.state == State::Deleted ? "deleted (" : "final (";
+        text += Hint::getRuleName(hint.rule);
+        text += ")\n";
+    }
+    TableFormatter::append(text, values, states, style);
+    return std::find(states.begin(), states.end(), State::Unknown) == states.end();
+}
 
-    class InvalidValueException : public std::range_error {
-    public:
-        InvalidValueException():
-            std::range_error("invalid value") { }
-    };
+int main(int argc, char **argv) {
+    std::ios::sync_with_stdio(false);
+
+    SolveOptions options;
+    auto jobCount = std::max(std::thread::hardware_concurrency(), 1U);
+    std::string outputFile;
+    auto pack = false;
+    auto showStats = false;
+    GeneratorOptions generatorOptions;
+    auto generateCount = 0ULL;
+    std::string cacheFile;
+    size_t cacheSize = 0;
+    std::string serveAddress;
+    auto maxPending = 0U;
+    auto maxConnections = 1024U;
+    auto explain = false;
+    std::string coordinateAddress;
+    std::string workAddress;
+    size_t shardSize = 1024;
+    std::string checkpointDirectory;
+    auto lease = std::chrono::milliseconds(600000);
+    auto retryLimit = 3U;
+    std::vector<std::string> inputs;
+    // The option that is unknown, lacks its value or has an invalid one.
+    std::string invalidArgument;
+    for (auto i = 1; i < argc && invalidArgument.empty(); i++) {
+        const std::string arg(argv[i]);
+        const auto readNumber = [&](auto &value) {
+            if (!parseNumber(argv[++i], value)) {
+                invalidArgument = arg + ' ' + argv[i];
+            }
+        };
 
-    class MultipleStateChangeException : public std::logic_error {
-    public:
-        MultipleStateChangeException():
-            std::logic_error("tried to set an entry's state multiple times") { }
-    };
+        if (arg == "--help") {
+            printUsage();
+            return 0;
 
-    class NoSolutionExistsException : public std::logic_error {
-    public:
-        NoSolutionExistsException(const std::string &reason) :
-            std::logic_error(reason) { }
-    };
+        } else if ((arg == "--threads" || arg == "--jobs") && i + 1 < argc) {
+            auto count = 0U;
+            readNumber(count);
+            if (count == 0) {
+                count = std::max(std::thread::hardware_concurrency(), 1U);
+            }
+            (arg == "--threads" ? options.threadCount : jobCount) = count;
 
-private:
-    const unsigned size;
-    std::vector<std::vector<Cell>> cells;
-    std::vector<std::vector<unsigned>> rowCounts, columnCounts;
-    unsigned unknownCellCount;
-    DisjointSets deletedTrees;
+        } else if (arg == "--count") {
+            options.mode = SolveMode::Count;
 
-public:
-    Table(const std::vector<std::vector<unsigned>> &initValues):
-        size(static_cast<unsigned>(initValues.size())),
-        rowCounts(size, std::vector<unsigned>(size + 1, 0)),
-        columnCounts(size, std::vector<unsigned>(size + 1, 0)),
-        unknownCellCount(size * size),
-        deletedTrees(size * size + 1) {
-
-        auto actRow = 0U;
-        for (const auto &row : initValues) {
-            if (row.size() != size) {
-                throw InvalidShapeException();
-            }
+        } else if (arg == "--unique") {
+            options.mode = SolveMode::Unique;
 
-            std::vector<Cell> rowCells;
-            auto actColumn = 0U;
-            for (auto value : row) {
-                if (value == 0 || value > size) {
-                    throw InvalidValueException();
-                }
-                rowCells.emplace_back(value);
+        } else if (arg == "--output" && i + 1 < argc) {
+            outputFile = argv[++i];
+            options.format = OutputFormat::Binary;
 
-                rowCounts[actRow][value]++;
-                columnCounts[actColumn][value]++;
+        } else if (arg == "--pack") {
+            pack = true;
 
-                actColumn++;
-            }
-            cells.push_back(std::move(rowCells));
+        } else if (arg == "--time-limit" && i + 1 < argc) {
+            auto milliseconds = 0ULL;
+            readNumber(milliseconds);
+            options.timeLimit = std::chrono::milliseconds(milliseconds);
 
-            actRow++;
-        }
-    }
+        } else if (arg == "--node-limit" && i + 1 < argc) {
+            readNumber(options.nodeLimit);
 
-    unsigned getSize() const {
-        return size;
-    }
+        } else if (arg == "--learn") {
+            options.learnNogoods = true;
 
-    auto begin() const {
-        return cells.cbegin();
-    }
+        } else if (arg == "--explain") {
+            explain = true;
 
-    auto end() const {
-        return cells.cend();
-    }
+        } else if (arg == "--stats") {
+            showStats = true;
 
-    bool isSolved() const {
-        return unknownCellCount == 0;
-    }
+        } else if (arg == "--cache" && i + 1 < argc) {
+            cacheFile = argv[++i];
 
-    void finalizeUniqueCells() {
-        for (auto r = 0U; r < size; r++) {
-            for (auto c = 0U; c < size; c++) {
-                auto &cell = cells[r][c];
-                if (cell.getState() == Cell::State::Unknown) {
-                    const auto value = cell.getValue();
-                    if (rowCounts[r][value] == 1 && columnCounts[c][value] == 1) {
-                        cell.setState(Cell::State::Final);
-                        rowCounts[r][value] = 0;
-                        columnCounts[c][value] = 0;
-                        unknownCellCount--;
-                    }
-                }
-            }
-        }
-    }
+        } else if (arg == "--cache-size" && i + 1 < argc) {
+            readNumber(cacheSize);
 
-    void finalizeCell(unsigned row, unsigned column) {
-        auto &cell = cells[row][column];
-        if (cell.getState() != Cell::State::Unknown) {
-            throw MultipleStateChangeException();
-        }
-        cell.setState(Cell::State::Final);
-
-        const auto value = cell.getValue();
-        rowCounts[row][value]--;
-        columnCounts[column][value]--;
-        unknownCellCount--;
-        
-        if (columnCounts[column][value] > 0) {
-            for (auto r = 0U; r < size; r++) {
-                auto &cell = cells[r][column];
-                if (r != row && cell.getValue() == value) {
-                    switch (cell.getState()) {
-                    case Cell::State::Final:
-                        throw NoSolutionExistsException("multiple finalized values found in a column");
-
-                    case Cell::State::Unknown:
-                        deleteCell(r, column);
-                    }
-                }
-            }
-        }
+        } else if (arg == "--serve" && i + 1 < argc) {
+            serveAddress = argv[++i];
 
-        if (rowCounts[row][value] > 0) {
-            for (auto c = 0U; c < size; c++) {
-                auto &cell = cells[row][c];
-                if (c != column && cell.getValue() == value) {
-                    switch (cell.getState()) {
-                    case Cell::State::Final:
-                        throw NoSolutionExistsException("multiple finalized values found in a row");
+        } else if (arg == "--max-pending" && i + 1 < argc) {
+            readNumber(maxPending);
 
-                    case Cell::State::Unknown:
-                        deleteCell(row, c);
-                    }
-                }
-            }
-        }
-    }
+        } else if (arg == "--max-clients" && i + 1 < argc) {
+            readNumber(maxConnections);
 
-    void deleteCell(unsigned row, unsigned column) {
-        auto &cell = cells[row][column];
-        if (cell.getState() != Cell::State::Unknown) {
-            throw MultipleStateChangeException();
-        }
+        } else if (arg == "--coordinate" && i + 1 < argc) {
+            coordinateAddress = argv[++i];
 
-        auto rOffs = 0;
-        auto cOffs = -1;
-        for (auto i = 0; i < 4; i++) {
-            const auto r = row + rOffs;
-            const auto c = column + cOffs;
-            if (r >= 0 && r < size && c >= 0 && c < size && cells[r][c].getState() == Cell::State::Deleted) {
-                throw NoSolutionExistsException("deleted neighbor found");
-            }
+        } else if (arg == "--work" && i + 1 < argc) {
+            workAddress = argv[++i];
 
-            auto t = rOffs;
-            rOffs = -cOffs;
-            cOffs = t;
-        }
+        } else if (arg == "--shard-size" && i + 1 < argc) {
+            readNumber(shardSize);
 
-        const auto cellSet = static_cast<int>(row * size + column + 1);
-        if (row == 0 || row == size - 1 || column == 0 || column == size - 1) {
-            deletedTrees.unionSets(0, cellSet);
-        }
+        } else if (arg == "--checkpoint" && i + 1 < argc) {
+            checkpointDirectory = argv[++i];
 
-        rOffs = -1;
-        cOffs = -1;
-        for (auto i = 0; i < 4; i++) {
-            const auto r = row + rOffs;
-            const auto c = column + cOffs;
-            const auto diagonalNeighborSet = static_cast<int>(r * size + c + 1);
-            if (r >= 0 && r < size && c >= 0 && c < size && cells[r][c].getState() == Cell::State::Deleted) {
-                const auto diagonalRoot = deletedTrees.findSet(diagonalNeighborSet);
-                const auto cellRoot = deletedTrees.findSet(cellSet);
-                if (diagonalRoot != cellRoot) {
-                    deletedTrees.linkSets(diagonalRoot, cellRoot);
+        } else if (arg == "--lease" && i + 1 < argc) {
+            auto milliseconds = 0ULL;
+            readNumber(milliseconds);
+            lease = std::chrono::milliseconds(milliseconds);
 
-                } else {
-                    throw NoSolutionExistsException("circular neighbors found");
-                }
-            }
+        } else if (arg == "--retries" && i + 1 < argc) {
+            readNumber(retryLimit);
 
-            auto t = rOffs;
-            rOffs = -cOffs;
-            cOffs = t;
-        }
+        } else if (arg == "--generate" && i + 1 < argc) {
+            readNumber(generateCount);
+
+        } else if (arg == "--size" && i + 1 < argc) {
+            readNumber(generatorOptions.size);
+
+        } else if (arg == "--min-branches" && i + 1 < argc) {
+            readNumber(generatorOptions.minBranchPoints);
 
-        cell.setState(Cell::State::Deleted);
+        } else if (arg == "--max-branches" && i + 1 < argc) {
+            readNumber(generatorOptions.maxBranchPoints);
 
-        const auto value = cell.getValue();
-        rowCounts[row][value]--;
-        columnCounts[column][value]--;
-        unknownCellCount--;
+        } else if (arg == "--seed" && i + 1 < argc) {
+            readNumber(generatorOptions.seed);
+
+        } else if (arg == "--format" && i + 1 < argc) {
+            const std::string style(argv[++i]);
+            if (style == "compact") {
+                options.style = TableFormatter::Style::Compact;
+            } else if (style == "mask") {
+                options.style = TableFormatter::Style::Mask;
+            } else if (style == "grid") {
+                options.style = TableFormatter::Style::Grid;
+            } else {
+                invalidArgument = arg + ' ' + style;
+            }
 
-        rOffs = 0;
-        cOffs = 1;
-        for (auto i = 0; i < 4; i++) {
-            const auto r = row + rOffs;
-            const auto c = column + cOffs;
-            if (r >= 0 && r < size && c >= 0 && c < size && cells[r][c].getState() == Cell::State::Unknown) {
-                finalizeCell(r, c);
+        } else if (arg == "--backend" && i + 1 < argc) {
+            const std::string backend(argv[++i]);
+            if (backend == "sat") {
+                options.backend = SolverBackendKind::Sat;
+            } else if (backend == "auto") {
+                options.backend = SolverBackendKind::Auto;
+            } else if (backend == "search") {
+                options.backend = SolverBackendKind::Search;
+            } else {
+                invalidArgument = arg + ' ' + backend;
             }
 
-            auto t = rOffs;
-            rOffs = -cOffs;
-            cOffs = t;
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            // Also an option missing its value.
+            invalidArgument = arg;
+
+        } else {
+            inputs.push_back(arg);
         }
     }
+    if (!invalidArgument.empty()) {
+        std::cout << "Invalid argument " << invalidArgument << '\n';
+        printUsage();
+        return 1;
+    }
+    if (pack && outputFile.empty()) {
+        std::cout << "--pack needs --output\n";
+        return 1;
+    }
+    if (!coordinateAddress.empty() && (inputs.size() != 1 || outputFile.empty())) {
+        std::cout << "--coordinate needs --output and exactly one corpus\n";
+        return 1;
+    }
 
-    auto getFinalizeCandidatePos() const {
-        auto rMax = 0U;
-        auto cMax = 0U;
-        auto maxCount = 0U;
-
-        for (auto r = 0U; r < size; r++) {
-            for (auto c = 0U; c < size; c++) {
-                for (auto v = 1U; v <= size; v++) {
-                    const auto &cell = cells[r][c];
-                    if (cell.getState() == Cell::State::Unknown) {
-                        auto actCount = rowCounts[r][v] + columnCounts[c][v] - 1;
-                        if (actCount > maxCount) {
-                            maxCount = actCount;
-                            rMax = r;
-                            cMax = c;
-                        }
-                    }
-                }
-            }
+    if (generateCount != 0) {
+        if (generatorOptions.size == 0 || generatorOptions.size > TableBase::MaxSize) {
+            std::cout << "invalid table shape\n";
+            return 2;
         }
 
-        return std::make_pair(rMax, cMax);
+        SearchStats totalStats;
+        const auto exitCode = writeGeneratedPuzzles(generatorOptions, generateCount, jobCount, outputFile, totalStats);
+        if (showStats) {
+            printStats(std::cerr, totalStats);
+        }
+        return exitCode;
     }
-};
 
-std::ostream& operator<<(std::ostream &out, const Table &t) {
-    auto tableSize = t.getSize();
-    auto digits = 0;
-    do {
-        tableSize /= 10;
-        digits++;
-    } while (tableSize > 0);
-
-    for (const auto &row : t) {
-        for (const auto &cell : row) {
-            switch (cell.getState()) {
-            case Table::Cell::State::Deleted:
-                out << std::setw(digits) << "-";
-                break;
-
-            case Table::Cell::State::Final:
-                out << std::setw(digits) << cell.getValue();
-                break;
-
-            case Table::Cell::State::Unknown:
-                out << std::setw(digits) << "?";
-                break;
+    // Rotated, mirrored and relabelled copies of a board share a result,
+    // so the cache pays off within a batch as well.
+    std::unique_ptr<SolveCache> cache;
+    if (!cacheFile.empty() || cacheSize != 0) {
+        cache.reset(new SolveCache(cacheSize != 0 ? cacheSize : 1 << 20));
+        options.cache = cache.get();
+
+        std::ifstream in(cacheFile, std::ios::binary);
+        if (!cacheFile.empty() && in.good()) {
+            try {
+                if (!isCorpus(in)) {
+                    throw std::runtime_error("not a corpus");
+                }
+                cache->load(in);
+            } catch (const std::exception &e) {
+                std::cout << "Unable to read the cache " << cacheFile << ": " << e.what() << '\n';
+                return 1;
             }
-            out << ' ';
         }
-        out << std::endl;
     }
 
-    return out;
-}
-
-Table readTable(std::istream &in) {
-    std::vector<std::vector<unsigned>> values;
-
-    while (!in.eof()) {
-        std::string line;
-        std::getline(in, line);
-        std::stringstream valueStream(line);
-
-        std::vector<unsigned> row;
-        while (valueStream.good()) {
-            unsigned v;
-            valueStream >> v;
-            if (valueStream.fail()) {
-                if (!valueStream.eof()) {
-                    throw std::logic_error("non numeric value encountered");
-                }
-            } else {
-                row.push_back(v);
+    SearchStats totalStats;
+    const auto finishRun = [&]() {
+        if (showStats) {
+            printStats(std::cerr, totalStats);
+            if (cache) {
+                printCacheStats(std::cerr, cache->getStats());
             }
         }
+        if (cache && !cacheFile.empty() && !saveCache(*cache, cacheFile)) {
+            std::cout << "Unable to write the cache " << cacheFile << '\n';
+            return false;
+        }
+        return true;
+    };
 
-        if (!row.empty()) {
-            if (!values.empty() && values.front().size() != row.size()) {
-                throw std::logic_error("invalid table shape");
-            }
+    if (!serveAddress.empty()) {
+        SolveServer server(options, jobCount, maxPending != 0 ? maxPending : 64 * jobCount);
+        if (serveAddress == "stdin") {
+            serveStandardStreams(server);
+        } else {
+#ifdef _WIN32
+            std::cout << "Only stdin can be served on Windows\n";
+            return 1;
+#else
+            std::cout << serveSocket(server, serveAddress, maxConnections) << '\n';
+            return 1;
+#endif
+        }
 
-            values.push_back(std::move(row));
+        const auto serverStats = server.getStats();
+        totalStats = serverStats.search;
+        if (showStats) {
+            std::cerr << "requests: " << serverStats.requests << '\n';
+            std::cerr << "errors: " << serverStats.errors << '\n';
+            std::cerr << "timeouts: " << serverStats.timeouts << '\n';
         }
+        return finishRun() ? 0 : 1;
     }
 
-    if (values.empty() || values.size() != values.front().size()) {
-        throw std::logic_error("invalid table shape");
+    if (!workAddress.empty()) {
+#ifdef _WIN32
+        std::cout << "Shards can't be worked on Windows\n";
+        return 1;
+#else
+        const auto error = workShards(workAddress, options, jobCount, totalStats);
+        if (!error.empty()) {
+            std::cout << error << '\n';
+        }
+        return finishRun() && error.empty() ? 0 : 1;
+#endif
     }
 
-    return Table(values);
-}
+    if (!coordinateAddress.empty()) {
+#ifdef _WIN32
+        std::cout << "Shards can't be coordinated on Windows\n";
+        return 1;
+#else
+        return coordinateShards(coordinateAddress, inputs.front(), outputFile,
+                                checkpointDirectory.empty() ? outputFile + ".shards" : checkpointDirectory,
+                                options, shardSize, lease, retryLimit, showStats);
+#endif
+    }
 
-Table solve(Table t) {
-    t.finalizeUniqueCells();
-    if (t.isSolved()) {
-        return t;
+    if (inputs.empty()) {
+        printUsage();
+        return 0;
     }
 
-    const auto pos = t.getFinalizeCandidatePos();
+    std::vector<std::string> files;
     try {
-        Table tCopy{ t };
-        tCopy.finalizeCell(pos.first, pos.second);
-        return solve(tCopy);
+        files = collectInputFiles(inputs);
+    } catch (const std::exception &e) {
+        std::cout << e.what() << '\n';
+        return 2;
+    }
+    for (const auto &file : files) {
+        if (file != "-" && !std::ifstream(file, std::ios::binary).good()) {
+            std::cout << "Unable to open " << file << " for reading\n";
+            return 1;
+        }
+    }
 
-    } catch (Table::NoSolutionExistsException e) {
-        t.deleteCell(pos.first, pos.second);
-        return solve(t);
+    // A single table prints on its own, so the first two are read to tell.
+    PuzzleReader reader(std::move(files));
+    Puzzle first;
+    Puzzle second;
+    if (!reader.read(first)) {
+        std::cout << "invalid table shape\n";
+        return 2;
     }
-}
+    const auto single = !reader.read(second);
+    auto readCount = 0U;
+    const auto nextPuzzle = [&](Puzzle &puzzle) {
+        readCount++;
+        if (readCount == 1 || (readCount == 2 && !single)) {
+            puzzle = std::move(readCount == 1 ? first : second);
+            return true;
+        }
+        return !single && reader.read(puzzle);
+    };
 
-int main(int argc, char **argv) {
-    if (argc != 2) {
-        std::cout << "Usage: HitoriSolver <table.txt>\n";
-        return 0;
+    if (explain) {
+        // One table at a time, the steps of a table are only known at its end.
+        auto success = true;
+        Puzzle puzzle;
+        while (nextPuzzle(puzzle)) {
+            std::string text;
+            if (!single) {
+                text += "# " + puzzle.id + '\n';
+            }
+            if (!puzzle.error.empty()) {
+                text += puzzle.error + '\n';
+                success = false;
+            } else {
+                success = explainTable(puzzle.values, options.style, text) && success;
+            }
+            if (!single) {
+                text += '\n';
+            }
+            std::cout.write(text.data(), static_cast<std::streamsize>(text.size()));
+        }
+        std::cout.flush();
+        return success ? 0 : 2;
     }
 
-    std::ifstream in(argv[1]);
-    if (!in.good()) {
-        std::cout << "Unable to open " << argv[1] << " for reading\n";
-        return 1;
+    if (!outputFile.empty()) {
+        std::ofstream out(outputFile, std::ios::binary | std::ios::trunc);
+        if (!out.good()) {
+            std::cout << "Unable to open " << outputFile << " for writing\n";
+            return 1;
+        }
+
+        // Malformed tables can't be stored, they are reported instead.
+        auto success = true;
+        CorpusWriter writer(out);
+        const auto writeRecord = [&](const Puzzle &puzzle, const SolveResult *result) {
+            auto error = result != nullptr ? result->error : puzzle.error;
+            if (error.empty()) {
+                try {
+                    writer.write(puzzle.values, result);
+                } catch (const std::exception &e) {
+                    error = e.what();
+                }
+            }
+            if (!error.empty()) {
+                std::cout << "# " << puzzle.id << '\n' << error << "\n\n";
+                success = false;
+            }
+        };
+
+        if (pack) {
+            Puzzle puzzle;
+            while (nextPuzzle(puzzle)) {
+                writeRecord(puzzle, nullptr);
+            }
+        } else {
+            success = solvePuzzles(nextPuzzle, options, single ? 1 : jobCount, [&](const Puzzle &puzzle, const SolveResult &result) {
+                writeRecord(puzzle, &result);
+                totalStats.merge(result.stats);
+            }) && success;
+        }
+        if (!finishRun()) {
+            return 1;
+        }
+
+        writer.finish();
+        if (!out.good()) {
+            std::cout << "Unable to write " << outputFile << '\n';
+            return 1;
+        }
+        return success ? 0 : 2;
+    }
+
+    if (!single) {
+        // The results are collected and written in large chunks.
+        std::string text;
+        const auto success = solvePuzzles(nextPuzzle, options, jobCount, [&](const Puzzle &puzzle, const SolveResult &result) {
+            text += "# ";
+            text += puzzle.id;
+            text += '\n';
+            text += result.error.empty() ? result.text : result.error + '\n';
+            text += '\n';
+            totalStats.merge(result.stats);
+            if (text.size() >= (1 << 16)) {
+                std::cout.write(text.data(), static_cast<std::streamsize>(text.size()));
+                text.clear();
+            }
+        });
+        std::cout.write(text.data(), static_cast<std::streamsize>(text.size()));
+        std::cout.flush();
+        if (!finishRun()) {
+            return 1;
+        }
+        return success ? 0 : 2;
     }
 
     try {
-        Table t = readTable(in);
-        std::cout << solve(t);
+        if (!first.error.empty()) {
+            throw std::logic_error(first.error);
+        }
+        const auto result = solveTable(first.values, options);
+        std::cout << result.text << std::flush;
+        totalStats.merge(result.stats);
+        if (!finishRun()) {
+            return 1;
+        }
+        return result.success ? 0 : 2;
 
-    } catch (std::exception e) {
-        std::cout << e.what() << std::endl;
+    } catch (const std::exception &e) {
+        std::cout << e.what() << '\n';
         return 2;
     }
-
-    in.close();
-
-    return 0;
 }
@@ -0,0 +1,538 @@
+#include "../HitoriSolver/Hitori.h"
+#include "../HitoriSolver/HitoriCluster.h"
+
+#include <cstdio>
+#include <random>
+#include <sstream>
+
+// Counts the minimal solutions of a board by trying every shading of
+// cells without deleted neighbors.
+class BruteForceCounter {
+private:
+    unsigned size;
+    std::vector<unsigned> values;
+    std::vector<char> deleted;
+    std::vector<unsigned> stack;
+    std::vector<char> seen;
+    unsigned long long count;
+
+public:
+    explicit BruteForceCounter(const TableValues &table):
+        size(table.size),
+        values(table.values),
+        deleted(size * size, 0),
+        count(0) { }
+
+    unsigned long long countMinimal() {
+        count = 0;
+        shade(0);
+        return count;
+    }
+
+    // Whether the shading, one byte per cell, is a minimal solution.
+    bool isMinimalSolution(const std::vector<char> &shading) {
+        deleted = shading;
+        for (auto pos = 0U; pos < size * size; pos++) {
+            if (deleted[pos] && ((pos >= size && deleted[pos - size]) || (pos % size != 0 && deleted[pos - 1]))) {
+                return false;
+            }
+        }
+        return isSolution() && isMinimal();
+    }
+
+private:
+    void shade(unsigned pos) {
+        if (pos == size * size) {
+            if (isSolution() && isMinimal()) {
+                count++;
+            }
+            return;
+        }
+        shade(pos + 1);
+        const auto row = pos / size;
+        const auto column = pos % size;
+        if ((row == 0 || !deleted[pos - size]) && (column == 0 || !deleted[pos - 1])) {
+            deleted[pos] = 1;
+            shade(pos + 1);
+            deleted[pos] = 0;
+        }
+    }
+
+    bool hasFinalCopy(unsigned pos) const {
+        const auto row = pos / size;
+        const auto column = pos % size;
+        for (auto i = 0U; i < size; i++) {
+            const auto inRow = row * size + i;
+            const auto inColumn = i * size + column;
+            if ((inRow != pos && !deleted[inRow] && values[inRow] == values[pos]) ||
+                (inColumn != pos && !deleted[inColumn] && values[inColumn] == values[pos])) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool isSolution() {
+        for (auto pos = 0U; pos < size * size; pos++) {
+            if (!deleted[pos]) {
+                const auto row = pos / size;
+                const auto column = pos % size;
+                for (auto i = 0U; i < size; i++) {
+                    const auto inRow = row * size + i;
+                    const auto inColumn = i * size + column;
+                    if ((inRow > pos && !deleted[inRow] && values[inRow] == values[pos]) ||
+                        (inColumn > pos && !deleted[inColumn] && values[inColumn] == values[pos])) {
+                        return false;
+                    }
+                }
+            }
+        }
+
+        // The final cells are connected.
+        const auto first = static_cast<unsigned>(std::find(deleted.begin(), deleted.end(), 0) - deleted.begin());
+        seen.assign(size * size, 0);
+        stack.assign(1, first);
+        seen[first] = 1;
+        auto reached = 1U;
+        while (!stack.empty()) {
+            const auto pos = stack.back();
+            stack.pop_back();
+            const auto row = pos / size;
+            const auto column = pos % size;
+            const unsigned neighbors[4] = { pos - size, pos - 1, pos + 1, pos + size };
+            const bool exists[4] = { row > 0, column > 0, column + 1 < size, row + 1 < size };
+            for (auto i = 0U; i < 4; i++) {
+                if (exists[i] && !deleted[neighbors[i]] && !seen[neighbors[i]]) {
+                    seen[neighbors[i]] = 1;
+                    reached++;
+                    stack.push_back(neighbors[i]);
+                }
+            }
+        }
+        return reached == size * size - static_cast<unsigned>(std::count(deleted.begin(), deleted.end(), 1));
+    }
+
+    bool isMinimal() const {
+        for (auto pos = 0U; pos < size * size; pos++) {
+            if (deleted[pos] && !hasFinalCopy(pos)) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+unsigned failureCount = 0;
+
+void check(bool condition, const std::string &message) {
+    if (!condition) {
+        std::printf("FAILED: %s\n", message.c_str());
+        failureCount++;
+    }
+}
+
+std::string describe(const TableValues &values) {
+    std::string text;
+    for (auto pos = 0U; pos < values.values.size(); pos++) {
+        text += std::to_string(values.values[pos]);
+        text += (pos + 1) % values.size == 0 ? '/' : ' ';
+    }
+    text.pop_back();
+    return text;
+}
+
+unsigned long long countSolutions(const TableValues &values, SolveOptions options) {
+    options.mode = SolveMode::Count;
+    options.format = OutputFormat::Binary;
+    return solveTable(values, options).solutionCount;
+}
+
+TableValues makeRandomTable(unsigned size, std::mt19937_64 &random) {
+    TableValues values{ size, std::vector<unsigned>(size * size) };
+    for (auto &value : values.values) {
+        value = static_cast<unsigned>(random() % size) + 1;
+    }
+    return values;
+}
+
+// Small boards with random values, most of them with many solutions, and
+// generated ones, which have fewer.
+std::vector<TableValues> getSmallBoards() {
+    std::vector<TableValues> boards;
+    boards.push_back({ 4, { 1, 3, 4, 3, 2, 4, 1, 3, 3, 3, 2, 4, 1, 2, 3, 4 } });
+
+    std::mt19937_64 random(1);
+    for (auto size = 2U; size <= 5; size++) {
+        for (auto i = 0U; i < 80; i++) {
+            boards.push_back(makeRandomTable(size, random));
+        }
+        for (auto i = 0U; i < 20; i++) {
+            boards.push_back(generateTable(size, random));
+        }
+    }
+    return boards;
+}
+
+// The search counts the minimal solutions, whatever order it branches in.
+void testSearchCountsMinimalSolutions() {
+    for (const auto &values : getSmallBoards()) {
+        const auto expected = BruteForceCounter(values).countMinimal();
+        SolveOptions options;
+        check(countSolutions(values, options) == expected, "search count of " + describe(values));
+        options.threadCount = 4;
+        check(countSolutions(values, options) == expected, "parallel search count of " + describe(values));
+    }
+}
+
+// A ParallelSolver searches table after table, even after a search stopped
+// at its limit with work left over.
+void testParallelSolverIsReusable() {
+    for (const auto &values : getSmallBoards()) {
+        const auto expected = BruteForceCounter(values).countMinimal();
+        visitTableType(values.size, [&](auto tableType) {
+            using TableType = typename decltype(tableType)::type;
+            ParallelSolver<TableType> solver(4);
+            for (const auto limit : { 1ULL, ~0ULL, 2ULL, ~0ULL }) {
+                TableType t(values);
+                const auto count = solver.countSolutions(t, limit);
+                check(count == std::min(expected, limit), "reused parallel search count of " + describe(values));
+            }
+        });
+    }
+}
+
+// Learning nogoods prunes the search, but keeps every minimal solution.
+void testLearningKeepsMinimalSolutions() {
+    for (const auto &values : getSmallBoards()) {
+        SolveOptions options;
+        options.learnNogoods = true;
+        check(countSolutions(values, options) == BruteForceCounter(values).countMinimal(),
+              "learning search count of " + describe(values));
+    }
+}
+
+// The backends count the same solutions, so their results can share the
+// cache and a corpus can be solved with any of them.
+void testBackendsCountMinimalSolutions() {
+    for (const auto &values : getSmallBoards()) {
+        const auto expected = BruteForceCounter(values).countMinimal();
+        SolveOptions options;
+        options.backend = SolverBackendKind::Sat;
+        check(countSolutions(values, options) == expected, "SAT count of " + describe(values));
+
+        // Every board goes to the SAT backend after a short probe.
+        options.backend = SolverBackendKind::Auto;
+        options.autoMinSize = 0;
+        options.autoProbeNodes = 2;
+        check(countSolutions(values, options) == expected, "auto count of " + describe(values));
+    }
+}
+
+// The copy of a board under one of the 8 symmetries of the square, bit 0
+// transposing it and bits 1 and 2 mirroring the rows and the columns, with
+// its values renamed by labels.
+TableValues transform(const TableValues &values, unsigned symmetry, const std::vector<unsigned> &labels) {
+    const auto size = values.size;
+    TableValues copy{ size, std::vector<unsigned>(size * size) };
+    for (auto row = 0U; row < size; row++) {
+        for (auto column = 0U; column < size; column++) {
+            auto sourceRow = (symmetry & 2) != 0 ? size - 1 - row : row;
+            auto sourceColumn = (symmetry & 4) != 0 ? size - 1 - column : column;
+            if ((symmetry & 1) != 0) {
+                std::swap(sourceRow, sourceColumn);
+            }
+            copy.values[row * size + column] = labels[values.values[sourceRow * size + sourceColumn] - 1];
+        }
+    }
+    return copy;
+}
+
+std::vector<char> unpackMask(const SolveResult &result, unsigned size) {
+    std::vector<char> shading(size * size);
+    for (auto pos = 0U; pos < size * size; pos++) {
+        shading[pos] = static_cast<char>(CorpusFormat::unpack(result.solutionMask.data(), pos, 1));
+    }
+    return shading;
+}
+
+// The result a cached search gives matches an uncached one: the count, and
+// a solution of the board asked for, not of the cached copy. If it is the
+// only solution, it is the same one.
+void checkCachedResult(const TableValues &values, const SolveResult &cached, const SolveResult &uncached,
+                       const std::string &name) {
+    check(cached.solutionCount == uncached.solutionCount && cached.exhaustive == uncached.exhaustive &&
+          cached.success == uncached.success, name + ", count");
+    if (cached.solutionCount == 0) {
+        check(cached.solutionMask.empty(), name + ", no solution");
+        return;
+    }
+    check(BruteForceCounter(values).isMinimalSolution(unpackMask(cached, values.size)), name + ", solution");
+    check(!uncached.exhaustive || uncached.solutionCount != 1 || cached.solutionMask == uncached.solutionMask,
+          name + ", unique solution");
+}
+
+// Every symmetric and relabelled copy of a board hits the entry of the
+// board, in every mode, and gets the result its own search would give.
+void testCacheMapsSymmetricCopies() {
+    std::mt19937_64 random(5);
+    for (const auto &values : getSmallBoards()) {
+        for (const auto mode : { SolveMode::Count, SolveMode::First, SolveMode::Unique }) {
+            SolveCache cache(1024);
+            SolveOptions options;
+            options.mode = mode;
+            options.format = OutputFormat::Binary;
+            options.cache = &cache;
+            solveTable(values, options);
+
+            std::vector<unsigned> labels(values.size);
+            for (auto i = 0U; i < values.size; i++) {
+                labels[i] = i + 1;
+            }
+            for (auto symmetry = 0U; symmetry < 8; symmetry++) {
+                std::shuffle(labels.begin(), labels.end(), random);
+                const auto copy = transform(values, symmetry, labels);
+                const auto hits = cache.getStats().hits;
+                const auto cached = solveTable(copy, options);
+                check(cache.getStats().hits == hits + 1, "cache hit of " + describe(copy));
+
+                auto uncachedOptions = options;
+                uncachedOptions.cache = nullptr;
+                checkCachedResult(copy, cached, solveTable(copy, uncachedOptions), "cached result of " + describe(copy));
+            }
+        }
+    }
+}
+
+// A saved cache loads back with every entry, in a cache of its own.
+void testCacheSaveAndLoad() {
+    const auto boards = getSmallBoards();
+    SolveCache cache(1 << 16);
+    SolveOptions options;
+    options.mode = SolveMode::Count;
+    options.format = OutputFormat::Binary;
+    options.cache = &cache;
+    for (const auto &values : boards) {
+        solveTable(values, options);
+    }
+
+    std::stringstream stream(std::ios::in | std::ios::out | std::ios::binary);
+    cache.save(stream);
+    check(isCorpus(stream), "saved cache is a corpus");
+    SolveCache loaded(1 << 16);
+    loaded.load(stream);
+    check(loaded.getStats().size == cache.getStats().size, "loaded cache size");
+
+    options.cache = &loaded;
+    auto uncachedOptions = options;
+    uncachedOptions.cache = nullptr;
+    for (const auto &values : boards) {
+        const auto hits = loaded.getStats().hits;
+        const auto cached = solveTable(values, options);
+        check(loaded.getStats().hits == hits + 1, "loaded cache hit of " + describe(values));
+        checkCachedResult(values, cached, solveTable(values, uncachedOptions), "loaded result of " + describe(values));
+    }
+}
+
+// The kinds of results the corpus and shard tests write and read back.
+enum class ResultKind {
+    Solved,
+    NoSolution,
+    TimedOut,
+    TimedOutWithSolution,
+    // An error instead of a result.
+    Failed,
+    // No result at all, a corpus only.
+    Unsearched
+};
+
+const ResultKind resultKinds[] = {
+    ResultKind::Solved, ResultKind::NoSolution, ResultKind::TimedOut, ResultKind::TimedOutWithSolution,
+    ResultKind::Failed, ResultKind::Unsearched
+};
+
+// A result like a search of a size by size table leaves, with a random
+// shading as its solution.
+SolveResult makeResult(unsigned size, ResultKind kind, std::mt19937_64 &random) {
+    SolveResult result;
+    if (kind == ResultKind::Failed) {
+        result.error = "the shard was lost by 4 workers";
+        return result;
+    }
+    result.timedOut = kind == ResultKind::TimedOut || kind == ResultKind::TimedOutWithSolution;
+    result.exhaustive = !result.timedOut;
+    if (kind == ResultKind::Solved || kind == ResultKind::TimedOutWithSolution) {
+        result.solutionCount = random() % 3 + 1;
+        std::vector<unsigned> shading(size * size);
+        for (auto &deleted : shading) {
+            deleted = static_cast<unsigned>(random() % 2);
+        }
+        CorpusFormat::pack(result.solutionMask, shading.data(), shading.size(), 1);
+    }
+    result.stats.nodes = random() % 1000000;
+    result.stats.branchPoints = random() % 1000;
+    return result;
+}
+
+bool isSameResult(const SolveResult &a, const SolveResult &b, bool withStats) {
+    return a.error == b.error && a.solutionCount == b.solutionCount && a.exhaustive == b.exhaustive &&
+        a.timedOut == b.timedOut && a.solutionMask == b.solutionMask &&
+        a.stats.nodes == (withStats ? b.stats.nodes : 0) &&
+        a.stats.branchPoints == (withStats ? b.stats.branchPoints : 0);
+}
+
+// A corpus reads back as written: the values of every size, packed in any
+// number of bits, and the results, with the search counts if the writer
+// kept them. A failed table keeps that it failed, not why.
+void testCorpusRoundTrip() {
+    std::mt19937_64 random(3);
+    for (const auto writeStats : { false, true }) {
+        std::vector<TableValues> tables;
+        std::vector<SolveResult> results;
+        std::vector<ResultKind> kinds;
+        for (const auto size : { 1U, 2U, 3U, 4U, 7U, 8U, 9U, 16U, 17U, 100U, 255U }) {
+            for (const auto kind : resultKinds) {
+                tables.push_back(makeRandomTable(size, random));
+                results.push_back(makeResult(size, kind, random));
+                kinds.push_back(kind);
+            }
+        }
+
+        std::stringstream stream(std::ios::in | std::ios::out | std::ios::binary);
+        CorpusWriter writer(stream, writeStats);
+        for (size_t i = 0; i < tables.size(); i++) {
+            writer.write(tables[i], kinds[i] != ResultKind::Unsearched ? &results[i] : nullptr);
+        }
+        writer.finish();
+
+        check(isCorpus(stream), "corpus header");
+        CorpusReader reader(stream);
+        check(reader.getRecordCount() == tables.size(), "corpus record count");
+        for (size_t i = 0; i < tables.size() && i < reader.getRecordCount(); i++) {
+            TableValues values;
+            SolveResult result;
+            const auto hasResult = reader.read(i, values, &result);
+            const auto name = "corpus record " + std::to_string(i) + " of size " + std::to_string(tables[i].size);
+            check(values.size == tables[i].size && values.values == tables[i].values, name + ", values");
+            check(hasResult == (kinds[i] != ResultKind::Unsearched), name + ", result flag");
+            if (kinds[i] == ResultKind::Failed) {
+                check(!result.error.empty() && result.solutionCount == 0 && result.solutionMask.empty(), name + ", error");
+            } else {
+                check(!hasResult || isSameResult(result, results[i], writeStats), name + ", result");
+            }
+        }
+    }
+}
+
+#ifndef _WIN32
+// A shard answer line reads back as the result it was written from, and
+// malformed lines are refused.
+void testShardResultRoundTrip() {
+    std::mt19937_64 random(4);
+    for (const auto size : { 1U, 2U, 5U, 8U, 13U, 64U, 255U }) {
+        for (const auto kind : resultKinds) {
+            if (kind == ResultKind::Unsearched) {
+                continue;
+            }
+            const auto index = random() % 100000;
+            const auto result = makeResult(size, kind, random);
+
+            std::string line;
+            appendShardResult(line, index, result);
+            const auto name = "shard line of size " + std::to_string(size) + ": " + line.substr(0, 40);
+            check(!line.empty() && line.back() == '\n' && line.find('\n') == line.size() - 1, name + ", one line");
+            line.pop_back();
+
+            auto parsedIndex = 0ULL;
+            SolveResult parsed;
+            check(parseShardResult(line, parsedIndex, parsed) && parsedIndex == index, name + ", parsed");
+            check(isSameResult(parsed, result, true), name + ", result");
+        }
+    }
+
+    // The line breaks of an error can't go into its line.
+    SolveResult result;
+    result.error = "two\nlines";
+    std::string line;
+    appendShardResult(line, 7, result);
+    line.pop_back();
+    auto index = 0ULL;
+    check(parseShardResult(line, index, result) && index == 7 && result.error == "two lines", "shard line of an error");
+
+    for (const auto malformed : { "", "7", "7 ", "x 1 1 0 0 -", "7 error ", "7 0 1 0 0 ff", "7 3 1 0 0 -",
+                                  "7 3 0 0 0 ff", "7 3 1 0 0 f", "7 3 1 0 0 fg", "7 3 1 0 -" }) {
+        check(!parseShardResult(malformed, index, result), std::string("malformed shard line ") + malformed);
+    }
+}
+#endif
+
+// Taking an edit back replays the later ones: each of them keeps its cell,
+// or is reported as dropped.
+void testEditorKeepsOrReportsEdits() {
+    using State = TableBase::Cell::State;
+    std::mt19937_64 random(2);
+    for (const auto &values : getSmallBoards()) {
+        visitTableType(values.size, [&](auto tableType) {
+            using TableType = typename decltype(tableType)::type;
+            TableType solution(values);
+            if (countSolutions(solution, 1) == 0) {
+                return;
+            }
+
+            const auto size = values.size;
+            BoardEditor<TableType> editor(values);
+            std::vector<unsigned> clicked;
+            for (auto pos = 0U; pos < size * size; pos++) {
+                // Cells the board forces can't be edited into anything else.
+                const auto state = random() % 2 == 0 ? State::Deleted : State::Final;
+                if (editor.getTable().getCell(pos / size, pos % size).getState() == State::Unknown &&
+                    editor.setCell(pos / size, pos % size, state) != BoardEditor<TableType>::Status::Contradiction) {
+                    clicked.push_back(pos);
+                }
+            }
+            while (!clicked.empty()) {
+                const auto taken = clicked[random() % clicked.size()];
+                std::vector<State> states;
+                for (const auto pos : clicked) {
+                    states.push_back(editor.getTable().getCell(pos / size, pos % size).getState());
+                }
+                editor.setCell(taken / size, taken % size, State::Unknown);
+                const auto &dropped = editor.getDroppedEdits();
+                std::vector<unsigned> kept;
+                for (auto i = 0U; i < clicked.size(); i++) {
+                    const auto pos = clicked[i];
+                    const auto isDropped = std::any_of(dropped.begin(), dropped.end(), [&](const auto &edit) {
+                        return edit.row * size + edit.column == pos;
+                    });
+                    if (pos == taken || isDropped) {
+                        continue;
+                    }
+                    check(editor.getTable().getCell(pos / size, pos % size).getState() == states[i],
+                          "edit kept after taking one back on " + describe(values));
+                    kept.push_back(pos);
+                }
+                clicked = kept;
+            }
+        });
+    }
+}
+
+int main() {
+    testSearchCountsMinimalSolutions();
+    testParallelSolverIsReusable();
+    testLearningKeepsMinimalSolutions();
+    testBackendsCountMinimalSolutions();
+    testEditorKeepsOrReportsEdits();
+    testCacheMapsSymmetricCopies();
+    testCacheSaveAndLoad();
+    testCorpusRoundTrip();
+#ifndef _WIN32
+    testShardResultRoundTrip();
+#endif
+
+    if (failureCount != 0) {
+        std::printf("%u checks failed\n", failureCount);
+        return 1;
+    }
+    std::printf("all checks passed\n");
+    return 0;
+}